@@ -0,0 +1,575 @@
+/*======================================================================
+//  cairo_painter.c - A painter drawing on any cairo context. It is
+//  used both by the gtk painter for the screen and for exporting to
+//  PNG, PDF, PostScript and SVG files.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <math.h>
+#include <cairo-pdf.h>
+#include <cairo-ps.h>
+#include <cairo-svg.h>
+#include <pango/pangocairo.h>
+#include "gxgraph.h"
+#include "cairo_painter.h"
+
+/* A text laid out in one of the text styles */
+typedef struct
+{
+  PangoLayout *layout;
+  int width, height;
+} text_layout_t;
+
+/* The number of text styles, T_AXIS and T_TITLE */
+#define NUM_TEXT_STYLES 2
+
+/* Most texts of a style kept laid out */
+#define TEXT_CACHE_MAX_SIZE 4096
+
+typedef struct
+{
+  painter_t painter;
+
+  cairo_t *cr;
+  PangoContext *pango_context;
+  PangoFontDescription *fonts[NUM_TEXT_STYLES];
+
+  /* The laid out texts of each style, by their text. They stay valid
+     as long as the fonts don't change. */
+  GHashTable *text_layouts[NUM_TEXT_STYLES];
+  GdkColor zero_color;
+
+  /* Only used when the painter owns its output */
+  cairo_surface_t *surface;
+  cairo_painter_format_t format;
+  FILE *OUT;
+  gboolean is_pipe;
+
+  // stateful variables
+  gint current_mark_type;
+  gdouble current_mark_size_x;
+  gdouble current_mark_size_y;
+  int current_line_style;
+} cairo_painter_t;
+
+#define PADDING         10
+#define SPACE           10
+#define TICKLENGTH      5
+
+static void
+cairo_painter_set_attributes (painter_t * painter,
+			      GdkColor color,
+			      double line_width,
+			      int line_style,
+			      gint mark_type,
+			      gdouble mark_size_x, gdouble mark_size_y);
+static void
+cairo_painter_draw_line (painter_t * painter,
+			 double x1, double y1, double x2, double y2);
+static void
+cairo_painter_draw_segments (painter_t * painter, GArray * segments);
+static void cairo_painter_draw_marks (painter_t * painter, GArray * marks);
+static void
+cairo_painter_draw_text (struct painter_t_struct *painter,
+			 double x_pos, double y_pos,
+			 const char *text, int just, int style);
+static void cairo_painter_set_attributes_style (painter_t * painter,
+						int style);
+static void cairo_painter_get_text_size (painter_t * painter,
+					 const char *text, int style,
+					 int *width, int *height);
+static void cairo_painter_nop ();
+
+static void
+text_layout_free (gpointer data)
+{
+  text_layout_t *text_layout = data;
+
+  g_object_unref (text_layout->layout);
+  g_free (text_layout);
+}
+
+static PangoFontDescription *
+new_font (double size)
+{
+  PangoFontDescription *font = pango_font_description_new ();
+
+  pango_font_description_set_family (font, "Sans");
+  pango_font_description_set_style (font, PANGO_STYLE_NORMAL);
+  pango_font_description_set_variant (font, PANGO_VARIANT_NORMAL);
+  pango_font_description_set_weight (font, PANGO_WEIGHT_NORMAL);
+  pango_font_description_set_stretch (font, PANGO_STRETCH_NORMAL);
+  pango_font_description_set_size (font, (int) size * PANGO_SCALE);
+
+  return font;
+}
+
+/* Pixel size of the widest character and of a line of a font */
+static void
+get_font_metrics (cairo_painter_t * cairo_painter, int style,
+		  int *char_width, int *line_height)
+{
+  PangoFontMetrics *metrics =
+    pango_context_get_metrics (cairo_painter->pango_context,
+			       cairo_painter->fonts[style], NULL);
+
+  *char_width = PANGO_PIXELS
+    (MAX (pango_font_metrics_get_approximate_char_width (metrics),
+	  pango_font_metrics_get_approximate_digit_width (metrics)));
+  *line_height = PANGO_PIXELS (pango_font_metrics_get_ascent (metrics)
+			       + pango_font_metrics_get_descent (metrics));
+  pango_font_metrics_unref (metrics);
+}
+
+painter_t *
+cairo_painter_new (window_t * window, cairo_t * cr)
+{
+  cairo_painter_t *this = g_new0 (cairo_painter_t, 1);
+  painter_t *parent = (painter_t *) this;
+  PangoLayout *layout;
+  int style;
+
+  this->cr = cairo_reference (cr);
+  this->format = CAIRO_PAINTER_FORMAT_NONE;
+  gdk_color_parse ("black", &this->zero_color);
+
+  // Setup pango painting. This should be more configurable...
+  layout = pango_cairo_create_layout (cr);
+  this->pango_context = g_object_ref (pango_layout_get_context (layout));
+  g_object_unref (layout);
+  this->fonts[T_AXIS] = new_font (8);
+  this->fonts[T_TITLE] = new_font (18);
+  for (style = 0; style < NUM_TEXT_STYLES; style++)
+    this->text_layouts[style] =
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+			     text_layout_free);
+
+  parent->set_attributes = cairo_painter_set_attributes;
+  parent->draw_segments = cairo_painter_draw_segments;
+  parent->draw_marks = cairo_painter_draw_marks;
+  parent->draw_line = cairo_painter_draw_line;
+  parent->draw_text = cairo_painter_draw_text;
+  parent->set_attributes_style = cairo_painter_set_attributes_style;
+  parent->get_text_size = cairo_painter_get_text_size;
+  parent->group_start = cairo_painter_nop;
+  parent->group_end = cairo_painter_nop;
+
+  /* Use the same layout as the gtk painter */
+  parent->area_w = window->width;
+  parent->area_h = window->height;
+  parent->bdr_pad = PADDING;
+  parent->axis_pad = SPACE;
+  parent->legend_pad = 0;
+  parent->tick_len = TICKLENGTH;
+  get_font_metrics (this, T_AXIS, &parent->axis_width,
+		    &parent->axis_height);
+  get_font_metrics (this, T_TITLE, &parent->title_width,
+		    &parent->title_height);
+  parent->units_per_inch = 96;
+
+  // Defaults that will be overriden
+  this->current_mark_type = 0;
+  this->current_mark_size_x = 1.0;
+  this->current_mark_size_y = 1.0;
+
+  return parent;
+}
+
+static cairo_status_t
+write_to_file (void *closure, const unsigned char *data, unsigned int length)
+{
+  FILE *OUT = (FILE *) closure;
+
+  if (fwrite (data, 1, length, OUT) != length)
+    return CAIRO_STATUS_WRITE_ERROR;
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+/* Create a painter that owns a surface of the given format. The
+   output is streamed to filename, which may also be a "|command" pipe
+   like for the PostScript painter. Returns NULL if the file can't be
+   opened. */
+painter_t *
+cairo_painter_new_for_file (window_t * window,
+			    const char *filename,
+			    cairo_painter_format_t format)
+{
+  cairo_painter_t *this;
+  cairo_surface_t *surface = NULL;
+  painter_t *painter;
+  gboolean is_pipe = FALSE;
+  FILE *OUT;
+  cairo_t *cr;
+
+  if (filename[0] == '|')
+    {
+      OUT = popen (&filename[1], "w");
+      is_pipe = TRUE;
+    }
+  else
+    OUT = fopen (filename, "wb");
+  if (!OUT)
+    return NULL;
+
+  switch (format)
+    {
+    case CAIRO_PAINTER_FORMAT_PNG:
+      surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					    window->width, window->height);
+      break;
+    case CAIRO_PAINTER_FORMAT_PDF:
+      surface = cairo_pdf_surface_create_for_stream (write_to_file, OUT,
+						     window->width,
+						     window->height);
+      break;
+    case CAIRO_PAINTER_FORMAT_PS:
+    case CAIRO_PAINTER_FORMAT_EPS:
+      surface = cairo_ps_surface_create_for_stream (write_to_file, OUT,
+						    window->width,
+						    window->height);
+      if (format == CAIRO_PAINTER_FORMAT_EPS)
+	cairo_ps_surface_set_eps (surface, TRUE);
+      break;
+    case CAIRO_PAINTER_FORMAT_SVG:
+      surface = cairo_svg_surface_create_for_stream (write_to_file, OUT,
+						     window->width,
+						     window->height);
+      break;
+    default:
+      break;
+    }
+
+  if (!surface || cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      if (surface)
+	cairo_surface_destroy (surface);
+      if (is_pipe)
+	pclose (OUT);
+      else
+	fclose (OUT);
+      return NULL;
+    }
+
+  cr = cairo_create (surface);
+
+  /* Paper background */
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_paint (cr);
+
+  painter = cairo_painter_new (window, cr);
+  cairo_destroy (cr);
+
+  this = (cairo_painter_t *) painter;
+  this->surface = surface;
+  this->format = format;
+  this->OUT = OUT;
+  this->is_pipe = is_pipe;
+
+  /* The vector surfaces are measured in points */
+  if (format != CAIRO_PAINTER_FORMAT_PNG)
+    painter->units_per_inch = 72;
+
+  return painter;
+}
+
+/* The color of the zero axis lines. The screen draws them in white on
+   top of the gray window background. */
+void
+cairo_painter_set_zero_color (painter_t * painter, GdkColor color)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+
+  cairo_painter->zero_color = color;
+}
+
+/* Finish the output of a painter created by cairo_painter_new_for_file
+   and free it. Returns 0 on success and -1 if writing failed. */
+int
+cairo_painter_delete (painter_t * painter)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+  cairo_status_t status = CAIRO_STATUS_SUCCESS;
+  int ret = 0;
+
+  int style;
+
+  for (style = 0; style < NUM_TEXT_STYLES; style++)
+    {
+      g_hash_table_destroy (cairo_painter->text_layouts[style]);
+      pango_font_description_free (cairo_painter->fonts[style]);
+    }
+  g_object_unref (cairo_painter->pango_context);
+  cairo_destroy (cairo_painter->cr);
+
+  if (cairo_painter->surface)
+    {
+      if (cairo_painter->format == CAIRO_PAINTER_FORMAT_PNG)
+	status = cairo_surface_write_to_png_stream (cairo_painter->surface,
+						    write_to_file,
+						    cairo_painter->OUT);
+      else
+	{
+	  cairo_surface_finish (cairo_painter->surface);
+	  status = cairo_surface_status (cairo_painter->surface);
+	}
+      cairo_surface_destroy (cairo_painter->surface);
+
+      if (cairo_painter->is_pipe)
+	pclose (cairo_painter->OUT);
+      else if (fclose (cairo_painter->OUT) != 0)
+	status = CAIRO_STATUS_WRITE_ERROR;
+
+      if (status != CAIRO_STATUS_SUCCESS)
+	{
+	  fprintf (stderr, "Failed writing output: %s\n",
+		   cairo_status_to_string (status));
+	  ret = -1;
+	}
+    }
+
+  g_free (cairo_painter);
+
+  return ret;
+}
+
+static void
+cairo_painter_set_attributes_style (painter_t * painter, int style)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+  GdkColor color;
+  int line_width;
+  int line_style = 0;
+
+  switch (style)
+    {
+    case L_AXIS:
+    default:
+      gdk_color_parse ("black", &color);
+      line_width = 1;
+      break;
+    case L_GRID:
+      gdk_color_parse ("gray80", &color);
+      line_width = 1;
+      break;
+    case L_ZERO:
+      color = cairo_painter->zero_color;
+      line_width = 2;
+      break;
+    }
+  cairo_painter_set_attributes (painter,
+				color, line_width, line_style, 0, 1.0, 1.0);
+}
+
+static void
+cairo_painter_set_attributes (painter_t * painter,
+			      GdkColor color,
+			      double line_width,
+			      int line_style,
+			      gint mark_type,
+			      gdouble mark_size_x, gdouble mark_size_y)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+
+  cairo_set_line_width (cairo_painter->cr, line_width);
+  cairo_set_line_cap (cairo_painter->cr, CAIRO_LINE_CAP_ROUND);
+  cairo_set_source_rgb (cairo_painter->cr,
+			color.red / 65535.0,
+			color.green / 65535.0, color.blue / 65535.0);
+  cairo_painter->current_line_style = line_style;
+
+  cairo_painter->current_mark_type = mark_type;
+  cairo_painter->current_mark_size_x = mark_size_x;
+  cairo_painter->current_mark_size_y = mark_size_y;
+}
+
+static void
+cairo_painter_draw_line (painter_t * painter,
+			 double x1, double y1, double x2, double y2)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+
+  cairo_move_to (cairo_painter->cr, x1, y1);
+  cairo_line_to (cairo_painter->cr, x2, y2);
+  cairo_stroke (cairo_painter->cr);
+}
+
+static void
+cairo_painter_draw_segments (painter_t * painter, GArray * segments)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+  seg_t *segs = (seg_t *) segments->data;
+  double clip_x0, clip_y0, clip_x1, clip_y1, margin;
+  int seg_idx;
+
+  /* Skip what is outside the clip, e.g. when drawing a tile */
+  cairo_clip_extents (cairo_painter->cr,
+		      &clip_x0, &clip_y0, &clip_x1, &clip_y1);
+  margin = cairo_get_line_width (cairo_painter->cr);
+  clip_y0 -= margin;
+  clip_y1 += margin;
+
+  for (seg_idx = 0; seg_idx < segments->len; seg_idx++)
+    {
+      if ((segs[seg_idx].y1 < clip_y0 && segs[seg_idx].y2 < clip_y0)
+	  || (segs[seg_idx].y1 > clip_y1 && segs[seg_idx].y2 > clip_y1))
+	continue;
+      cairo_move_to (cairo_painter->cr, segs[seg_idx].x1, segs[seg_idx].y1);
+      cairo_line_to (cairo_painter->cr, segs[seg_idx].x2, segs[seg_idx].y2);
+    }
+  cairo_stroke (cairo_painter->cr);
+}
+
+static void
+draw_one_mark (cairo_t * cr,
+	       int x, int y,
+	       int mark_type,
+	       double size_x,
+	       double size_y, gboolean * need_stroke, gboolean * need_fill)
+{
+  double rx = size_x / 2, ry = size_y / 2;	// Mark size
+  if (mark_type == MARK_TYPE_CIRCLE)
+    {
+      cairo_move_to (cr, x + rx, y);
+      cairo_arc (cr, x, y, rx, 0.0, 2 * G_PI);
+      *need_stroke = 1;
+    }
+  else if (mark_type == MARK_TYPE_FCIRCLE)
+    {
+      cairo_move_to (cr, x + rx, y);
+      cairo_arc (cr, x, y, rx, 0.0, 2 * G_PI);
+      *need_fill = 1;
+    }
+  else if (mark_type == MARK_TYPE_SQUARE)
+    {
+      cairo_move_to (cr, x - rx, y - ry);
+      cairo_rectangle (cr, x - rx, y - ry, 2 * rx, 2 * ry);
+      *need_stroke = 1;
+    }
+  else if (mark_type == MARK_TYPE_FSQUARE)
+    {
+      cairo_rectangle (cr, x - rx, y - ry, 2 * rx, 2 * ry);
+      *need_fill = 1;
+    }
+}
+
+static void
+cairo_painter_draw_marks (painter_t * painter, GArray * marks_array)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+  mark_t *marks = (mark_t *) marks_array->data;
+  int m_idx;
+  gboolean need_stroke = FALSE;
+  gboolean need_fill = FALSE;
+  double clip_x0, clip_y0, clip_x1, clip_y1, margin;
+
+  cairo_clip_extents (cairo_painter->cr,
+		      &clip_x0, &clip_y0, &clip_x1, &clip_y1);
+  margin = cairo_painter->current_mark_size_y
+    + cairo_get_line_width (cairo_painter->cr);
+  clip_y0 -= margin;
+  clip_y1 += margin;
+
+  for (m_idx = 0; m_idx < marks_array->len; m_idx++)
+    if (marks[m_idx].y >= clip_y0 && marks[m_idx].y <= clip_y1)
+      draw_one_mark (cairo_painter->cr,
+		     marks[m_idx].x,
+		     marks[m_idx].y,
+		     cairo_painter->current_mark_type,
+		     cairo_painter->current_mark_size_x,
+		     cairo_painter->current_mark_size_y,
+		     &need_stroke, &need_fill);
+  if (need_stroke)
+    cairo_stroke (cairo_painter->cr);
+  if (need_fill)
+    cairo_fill (cairo_painter->cr);
+}
+
+/* The layout of a text, laid out only the first time it is drawn */
+static text_layout_t *
+get_text_layout (cairo_painter_t * cairo_painter, const char *text,
+		 int style)
+{
+  GHashTable *text_layouts = cairo_painter->text_layouts[style];
+  text_layout_t *text_layout = g_hash_table_lookup (text_layouts, text);
+  PangoRectangle log_rect;
+
+  if (text_layout)
+    return text_layout;
+
+  /* Texts that change all the time shouldn't fill the memory */
+  if (g_hash_table_size (text_layouts) >= TEXT_CACHE_MAX_SIZE)
+    g_hash_table_remove_all (text_layouts);
+
+  text_layout = g_new (text_layout_t, 1);
+  text_layout->layout = pango_layout_new (cairo_painter->pango_context);
+  pango_layout_set_font_description (text_layout->layout,
+				     cairo_painter->fonts[style]);
+  pango_layout_set_text (text_layout->layout, text, -1);
+  pango_layout_get_pixel_extents (text_layout->layout, NULL, &log_rect);
+  text_layout->width = log_rect.width;
+  text_layout->height = log_rect.height;
+  g_hash_table_insert (text_layouts, g_strdup (text), text_layout);
+
+  return text_layout;
+}
+
+/* The size of a text from its cached layout */
+static void
+cairo_painter_get_text_size (painter_t * painter, const char *text,
+			     int style, int *width, int *height)
+{
+  text_layout_t *text_layout =
+    get_text_layout ((cairo_painter_t *) painter, text,
+		     style == T_TITLE ? T_TITLE : T_AXIS);
+
+  *width = text_layout->width;
+  *height = text_layout->height;
+}
+
+static void
+cairo_painter_draw_text (struct painter_t_struct *painter,
+			 double x_pos, double y_pos,
+			 const char *text, int just, int style)
+{
+  cairo_painter_t *cairo_painter = (cairo_painter_t *) painter;
+  text_layout_t *text_layout;
+  int layout_width, layout_height;
+
+  if (style != T_TITLE)
+    style = T_AXIS;
+  text_layout = get_text_layout (cairo_painter, text, style);
+  layout_width = text_layout->width;
+  layout_height = text_layout->height;
+
+  cairo_set_source_rgb (cairo_painter->cr, 0, 0, 0);
+
+  if (just == T_RIGHT)
+    {
+      x_pos -= layout_width;
+      y_pos -= layout_height / 2;
+    }
+  else if (just == T_LOWERLEFT)
+    y_pos -= layout_height;
+  else if (just == T_UPPERLEFT)
+    y_pos -= 0;
+  else if (just == T_BOTTOM)
+    {
+      y_pos -= layout_height;
+      x_pos -= layout_width / 2;
+    }
+  else if (just == T_TOP)
+    x_pos -= layout_width / 2;
+
+  cairo_move_to (cairo_painter->cr, x_pos, y_pos);
+  pango_cairo_show_layout (cairo_painter->cr, text_layout->layout);
+}
+
+static void
+cairo_painter_nop ()
+{
+}
@@ -0,0 +1,32 @@
+/*======================================================================
+//  cairo_painter.h - painter for any cairo surface
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef CAIRO_PAINTER_H
+#define CAIRO_PAINTER_H
+
+#include <cairo.h>
+#include "gxgraph.h"
+
+typedef enum
+{
+  CAIRO_PAINTER_FORMAT_NONE,
+  CAIRO_PAINTER_FORMAT_PNG,
+  CAIRO_PAINTER_FORMAT_PDF,
+  CAIRO_PAINTER_FORMAT_PS,
+  CAIRO_PAINTER_FORMAT_EPS,
+  CAIRO_PAINTER_FORMAT_SVG
+} cairo_painter_format_t;
+
+painter_t *cairo_painter_new (window_t * window, cairo_t * cr);
+painter_t *cairo_painter_new_for_file (window_t * window,
+				       const char *filename,
+				       cairo_painter_format_t format);
+void cairo_painter_set_zero_color (painter_t * painter, GdkColor color);
+int cairo_painter_delete (painter_t * painter);
+
+#endif /* CAIRO_PAINTER */
@@ -7,11 +7,17 @@
 //----------------------------------------------------------------------
 */
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
+#include <pango/pangocairo.h>
 #include "moving_ants.h"
 #include "gxgraph.h"
 #include "gxgraph_hardcopy.h"
 #include "gxgraph_about.h"
+#include "cairo_painter.h"
+#include "gxgraph_trace.h"
+#include "gxgraph_memstats.h"
+#include "gtk_painter.h"
 
 #include "pixmap_gxgraph.i"
 
@@ -55,6 +61,9 @@ gtk_painter_draw_text (struct painter_t_struct *painter,
 		       double x_pos, double y_pos,
 		       const char *text, int just, int style);
 static void gtk_painter_set_attributes_style (painter_t * painter, int style);
+static void gtk_painter_get_text_size (painter_t * painter,
+				       const char *text, int style,
+				       int *width, int *height);
 
 static void gtk_painter_nop ();
 static gint cb_zero_on_destroy (GtkObject * widget, gpointer userdata);
@@ -68,22 +77,22 @@ typedef struct
   GtkWidget *drawing_area;
   GtkWidget *vbox;
   GtkWidget *button_box;
-  PangoLayout *pango_layout;
-  PangoContext *pango_context;
-  PangoFontDescription *pango_font_description;
   moving_ants_t *moving_ants;
   GdkPixmap *pixmap;
   GtkWidget *gxgraph_hardcopy;
   cairo_t *cr;
 
+  // All drawing is done by a cairo painter on the pixmap
+  painter_t *cairo_painter;
+
+  // Statistics of the last drawing, shown in the overlay
+  render_stats_t render_stats;
+  gboolean do_show_hud;
+
   // stateful variables
   gboolean is_defining_zoom_area;
   gint start_cx;
   gint start_cy;
-  gint current_mark_type;
-  gdouble current_mark_size_x;
-  gdouble current_mark_size_y;
-  int current_line_style;
 } gtk_painter_t;
 
 #define PADDING         10
@@ -95,17 +104,18 @@ gtk_painter_new (window_t * window)
 {
   gtk_painter_t *this = g_new0 (gtk_painter_t, 1);
   painter_t *parent = (painter_t *) this;
-  const char *font_family = "Sans";
-  GError *err = NULL;
-  GdkPixbuf *icon = gdk_pixbuf_new_from_inline(sizeof(pixmap_gxgraph_inline),
-                                               pixmap_gxgraph_inline,
-                                               TRUE,
-                                               &err);
+  /* Decoded once for all the windows, which a server keeps opening */
+  static GdkPixbuf *icon = NULL;
+
+  if (!icon)
+    icon = gdk_pixbuf_new_from_inline(sizeof(pixmap_gxgraph_inline),
+                                      pixmap_gxgraph_inline,
+                                      TRUE,
+                                      NULL);
 
   this->w_toplevel = gtk_window_new (GTK_WINDOW_TOPLEVEL);
   gtk_window_set_icon (GTK_WINDOW (this->w_toplevel),
                        icon);
-  g_object_unref(icon);
   gtk_widget_set_size_request (this->w_toplevel,
 			       window->width, window->height);
 
@@ -142,22 +152,6 @@ gtk_painter_new (window_t * window)
   // Before showing we must assign the pointer...
   window->gtk_painter = (painter_t *) this;
 
-  // Setup pango painting
-  this->pango_context = gtk_widget_get_pango_context (this->drawing_area);
-  this->pango_layout = pango_layout_new (this->pango_context);
-  this->pango_font_description = pango_font_description_new ();
-  pango_font_description_set_family (this->pango_font_description,
-				     g_strdup (font_family));
-  pango_font_description_set_style (this->pango_font_description,
-				    PANGO_STYLE_NORMAL);
-  pango_font_description_set_variant (this->pango_font_description,
-				      PANGO_VARIANT_NORMAL);
-  pango_font_description_set_weight (this->pango_font_description,
-				     PANGO_WEIGHT_NORMAL);
-  pango_font_description_set_stretch (this->pango_font_description,
-				      PANGO_STRETCH_NORMAL);
-
-
   parent->set_attributes = gtk_painter_set_attributes;
   parent->draw_segments = gtk_painter_draw_segments;
   parent->draw_marks = gtk_painter_draw_marks;
@@ -176,17 +170,15 @@ gtk_painter_new (window_t * window)
   parent->axis_height = 13;
   parent->title_width = 5;
   parent->title_height = 5;
+  parent->stats = &this->render_stats;
 
   // Create a moving ants structure for the selection of a zoom area
   this->moving_ants = NULL;
 
-  // This will be created in the configure event
+  // These will be created in the configure event
   this->pixmap = NULL;
-
-  // Defaults that will be overriden
-  this->current_mark_type = 0;
-  this->current_mark_size_x = 1.0;
-  this->current_mark_size_y = 1.0;
+  this->cr = NULL;
+  this->cairo_painter = NULL;
 
   // Show it all
   gtk_widget_show (this->vbox);
@@ -201,6 +193,50 @@ gtk_painter_delete (painter_t * painter)
 {
   gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
   gtk_widget_destroy (gtk_painter->w_toplevel);
+
+  if (gtk_painter->cairo_painter)
+    cairo_painter_delete (gtk_painter->cairo_painter);
+  gtk_painter->cairo_painter = NULL;
+  if (gtk_painter->cr)
+    cairo_destroy (gtk_painter->cr);
+  gtk_painter->cr = NULL;
+  if (gtk_painter->render_stats.datasets)
+    g_array_free (gtk_painter->render_stats.datasets, TRUE);
+  gtk_painter->render_stats.datasets = NULL;
+}
+
+static glong
+pixmap_bytes (GdkPixmap * pixmap)
+{
+  int width, height, depth;
+
+  if (!pixmap)
+    return 0;
+
+  gdk_drawable_get_size (GDK_DRAWABLE (pixmap), &width, &height);
+  depth = gdk_drawable_get_depth (GDK_DRAWABLE (pixmap));
+
+  return (glong) width * height * (depth > 16 ? 4 : depth > 8 ? 2 : 1);
+}
+
+/* Bytes held by the backing store and the zoom selection */
+glong
+gtk_painter_get_memory_size (painter_t * painter)
+{
+  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
+  glong bytes = sizeof (gtk_painter_t) + pixmap_bytes (gtk_painter->pixmap);
+
+  if (gtk_painter->moving_ants)
+    {
+      int side_idx;
+
+      bytes += sizeof (moving_ants_t);
+      for (side_idx = 0; side_idx < 4; side_idx++)
+	bytes +=
+	  pixmap_bytes (gtk_painter->moving_ants->backing_storage[side_idx]);
+    }
+
+  return bytes;
 }
 
 static void
@@ -281,6 +317,7 @@ cb_configure_event (GtkWidget * widget,
   double max_x = window->world.x1;
   double min_y = window->world.y0;
   double max_y = window->world.y1;
+  GdkColor zero_color;
 
   window->width = width;
   window->height = height;
@@ -299,7 +336,10 @@ cb_configure_event (GtkWidget * widget,
     gdk_pixmap_unref (gtk_painter->pixmap);
   gtk_painter->pixmap = gdk_pixmap_new (widget->window, width, height, -1);
 
-  
+  if (gtk_painter->cairo_painter)
+    cairo_painter_delete (gtk_painter->cairo_painter);
+  if (gtk_painter->cr)
+    cairo_destroy (gtk_painter->cr);
   gtk_painter->cr = gdk_cairo_create(GDK_DRAWABLE(gtk_painter->pixmap));
   gdk_cairo_set_source_color(gtk_painter->cr,&widget->style->bg[GTK_STATE_NORMAL]);
   cairo_rectangle(gtk_painter->cr,
@@ -307,23 +347,122 @@ cb_configure_event (GtkWidget * widget,
                   widget->allocation.width, widget->allocation.height);
   cairo_fill(gtk_painter->cr);
 
+  gtk_painter->cairo_painter = cairo_painter_new (window, gtk_painter->cr);
+  gdk_color_parse ("white", &zero_color);
+  cairo_painter_set_zero_color (gtk_painter->cairo_painter, zero_color);
+
+  /* Lay out the window for the fonts that it is drawn with */
+  painter->axis_width = gtk_painter->cairo_painter->axis_width;
+  painter->axis_height = gtk_painter->cairo_painter->axis_height;
+  painter->title_width = gtk_painter->cairo_painter->title_width;
+  painter->title_height = gtk_painter->cairo_painter->title_height;
+  painter->get_text_size = gtk_painter_get_text_size;
+
   gxgraph_draw_window (window, NULL);
 
   return TRUE;
 }
 
+/* Most datasets listed in the overlay */
+#define HUD_MAX_DATASETS 12
+
+/* Draw the statistics of the last drawing on top of the window. This
+   is drawn on the window and not on the pixmap so that it is not
+   part of what it measures. */
+static void
+draw_hud (window_t * window, GtkWidget * widget, GdkRectangle * area)
+{
+  gtk_painter_t *gtk_painter = (gtk_painter_t *) window->gtk_painter;
+  render_stats_t *stats = &gtk_painter->render_stats;
+  GString *text = g_string_new (NULL);
+  glong num_submitted = 0, num_drawn = 0;
+  PangoFontDescription *font;
+  PangoLayout *layout;
+  dataset_t *ds_p;
+  cairo_t *cr;
+  int ds_idx, num_datasets = 0;
+  int width, height;
+
+  if (stats->datasets)
+    num_datasets = stats->datasets->len;
+
+  g_string_append_printf (text, "frame %8.2f ms\n", stats->seconds * 1e3);
+  g_string_append_printf (text, "text  %8.2f ms\n",
+			  stats->text_seconds * 1e3);
+  g_string_append_printf (text, "grid  %8.2f ms\n",
+			  stats->grid_seconds * 1e3);
+  g_string_append_printf (text, "data  %8.2f ms\n",
+			  stats->data_seconds * 1e3);
+
+  for (ds_idx = 0; ds_idx < num_datasets && ds_idx < window->datasets->len;
+       ds_idx++)
+    {
+      dataset_stats_t *ds_stats =
+	&g_array_index (stats->datasets, dataset_stats_t, ds_idx);
+      const char *name;
+
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
+      name = ds_p->set_name ? ds_p->set_name : "";
+
+      num_submitted += ds_stats->num_submitted;
+      num_drawn += ds_stats->num_drawn;
+      if (ds_idx < HUD_MAX_DATASETS)
+	g_string_append_printf (text, "  %-16.*s %8.2f ms %9ld/%ld\n",
+				(int) MIN (strcspn (name, "\r\n"), 16), name,
+				ds_stats->seconds * 1e3,
+				ds_stats->num_drawn, ds_stats->num_submitted);
+    }
+  if (num_datasets > HUD_MAX_DATASETS)
+    g_string_append_printf (text, "  ... and %d more datasets\n",
+			    num_datasets - HUD_MAX_DATASETS);
+
+  g_string_append_printf (text, "primitives %ld drawn of %ld\n",
+			  num_drawn, num_submitted);
+  if (stats->lod_dpi > 0)
+    g_string_append_printf (text, "lod %g dpi", stats->lod_dpi);
+  else
+    g_string_append (text, "lod off");
+
+  cr = gdk_cairo_create (widget->window);
+  gdk_cairo_rectangle (cr, area);
+  cairo_clip (cr);
+
+  layout = pango_cairo_create_layout (cr);
+  font = pango_font_description_from_string ("Monospace 8");
+  pango_layout_set_font_description (layout, font);
+  pango_layout_set_text (layout, text->str, -1);
+  pango_layout_get_pixel_size (layout, &width, &height);
+
+  cairo_set_source_rgba (cr, 0, 0, 0, 0.7);
+  cairo_rectangle (cr, 4, 4, width + 8, height + 8);
+  cairo_fill (cr);
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_move_to (cr, 8, 8);
+  pango_cairo_show_layout (cr, layout);
+
+  pango_font_description_free (font);
+  g_object_unref (layout);
+  cairo_destroy (cr);
+  g_string_free (text, TRUE);
+}
+
 static gint
 cb_expose_event (GtkWidget * widget, GdkEventExpose * event,
 		 window_t * window)
 {
   gtk_painter_t *gtk_painter = (gtk_painter_t *) window->gtk_painter;
 
+  TRACE_BEGIN ("expose", NULL);
   gdk_draw_drawable (widget->window,
 		     widget->style->fg_gc[GTK_WIDGET_STATE (widget)],
 		     gtk_painter->pixmap,
 		     event->area.x, event->area.y,
 		     event->area.x, event->area.y,
 		     event->area.width, event->area.height);
+  TRACE_END ("expose");
+
+  if (gtk_painter->do_show_hud)
+    draw_hud (window, widget, &event->area);
 
   return FALSE;
 }
@@ -367,6 +506,127 @@ cb_motion_event (GtkWidget * widget,
   return TRUE;
 }
 
+/* Show the datasets in the window again with the given world, or
+   fitted to the data if world is NULL, e.g. after the scale of an axis
+   has changed */
+void
+gtk_painter_redraw (window_t * window, GPtrArray * datasets, world_t * world)
+{
+  gtk_painter_t *gtk_painter = (gtk_painter_t *) window->gtk_painter;
+  GtkWidget *widget = gtk_painter->drawing_area;
+
+  if (!gtk_painter->cr)
+    return;
+
+  gdk_cairo_set_source_color (gtk_painter->cr,
+			      &widget->style->bg[GTK_STATE_NORMAL]);
+  cairo_paint (gtk_painter->cr);
+  put_datasets_in_window (datasets, window, world);
+  gtk_widget_queue_draw (widget);
+}
+
+/* Draw only the points appended to the datasets on the backing store,
+   and expose the area that they cover. Returns FALSE if the window
+   must be redrawn in full. */
+gboolean
+gtk_painter_draw_appended (window_t * window)
+{
+  gtk_painter_t *gtk_painter = (gtk_painter_t *) window->gtk_painter;
+  GdkRectangle damage;
+
+  if (!gtk_painter->cr || !gxgraph_draw_appended (window, &damage))
+    return FALSE;
+
+  if (damage.width > 0 && damage.height > 0)
+    gtk_widget_queue_draw_area (gtk_painter->drawing_area, damage.x,
+				damage.y, damage.width, damage.height);
+
+  return TRUE;
+}
+
+/* Scroll a window that shows a strip of the newest points along with
+   them. The plot on the backing store is moved left, and only the
+   columns at its edges and the x axis labels are drawn again. Returns
+   FALSE if the window must be drawn otherwise. */
+gboolean
+gtk_painter_scroll (window_t * window)
+{
+  gtk_painter_t *gtk_painter = (gtk_painter_t *) window->gtk_painter;
+  painter_t *painter = window->gtk_painter;
+  GtkWidget *widget = gtk_painter->drawing_area;
+  cairo_surface_t *surface;
+  render_stats_t *stats = painter->stats;
+  GTimer *timer;
+  world_t world;
+  int margin = painter->bdr_pad / 2;
+  int edge = painter->tick_len + 2;
+  int left, right, top, bottom, column, shift;
+
+  if (!gtk_painter->cr)
+    return FALSE;
+  shift = gxgraph_get_scroll (window, &world, &column);
+
+  /* The ticks and frame at the edges of the plot stay where they are */
+  left = window->org_x + edge;
+  right = window->opp_x - edge;
+  column = MIN (column, right - shift);
+  if (shift <= 0 || column <= left)
+    return FALSE;
+  top = window->org_y - margin;
+  bottom = window->opp_y + margin;
+
+  TRACE_BEGIN ("scroll", NULL);
+  timer = g_timer_new ();
+  surface = cairo_get_target (gtk_painter->cr);
+  cairo_surface_flush (surface);
+  gdk_draw_drawable (gtk_painter->pixmap,
+		     widget->style->fg_gc[GTK_WIDGET_STATE (widget)],
+		     gtk_painter->pixmap,
+		     left + shift, top, left, top, column - left,
+		     bottom - top + 1);
+  cairo_surface_mark_dirty (surface);
+
+  window->world.x0 = world.x0;
+  window->world.x1 = world.x1;
+  compute_transform (window, painter);
+
+  /* Draw the edges of the plot, the strip of the new points and the x
+     axis labels again */
+  cairo_save (gtk_painter->cr);
+  cairo_rectangle (gtk_painter->cr, window->org_x - margin, top,
+		   edge + margin, bottom - top + 1);
+  cairo_rectangle (gtk_painter->cr, column, top,
+		   window->opp_x + margin - column + 1, bottom - top + 1);
+  cairo_rectangle (gtk_painter->cr, 0, bottom + 1,
+		   painter->area_w, painter->area_h - bottom - 1);
+  cairo_clip (gtk_painter->cr);
+  gdk_cairo_set_source_color (gtk_painter->cr,
+			      &widget->style->bg[GTK_STATE_NORMAL]);
+  cairo_paint (gtk_painter->cr);
+
+  gxgraph_draw_legend (window, painter);
+  gxgraph_draw_grid_and_axis (window, painter);
+  gxgraph_draw_data_columns (window, painter, window->org_x - margin,
+			     left);
+
+  /* The overlay shows the strip of the new points */
+  if (stats->datasets)
+    g_array_set_size (stats->datasets, 0);
+  gxgraph_draw_data_columns (window, painter, column,
+			     window->opp_x + margin);
+  cairo_restore (gtk_painter->cr);
+
+  stats->seconds = stats->data_seconds = g_timer_elapsed (timer, NULL);
+  stats->text_seconds = stats->grid_seconds = 0;
+  g_timer_destroy (timer);
+  TRACE_END ("scroll");
+
+  gtk_widget_queue_draw_area (widget, 0, top, painter->area_w,
+			      painter->area_h - top);
+
+  return TRUE;
+}
+
 static gint
 cb_key_press_event (GtkWidget * widget, GdkEventKey * event,
 		    gpointer user_data)
@@ -385,6 +645,32 @@ cb_key_press_event (GtkWidget * widget, GdkEventKey * event,
     case 'Q':
       gtk_main_quit ();
       break;
+    case 'f':
+    case 'F':
+      gtk_painter->do_show_hud = !gtk_painter->do_show_hud;
+      gtk_widget_queue_draw (gtk_painter->drawing_area);
+      break;
+    case 'x':
+    case 'X':
+      window->do_logx = !window->do_logx;
+      gtk_painter_redraw (window, window->datasets, NULL);
+      break;
+    case 'y':
+    case 'Y':
+      window->do_logy = !window->do_logy;
+      gtk_painter_redraw (window, window->datasets, NULL);
+      break;
+    case 'm':
+    case 'M':
+      {
+	window_t *first_window = window;
+
+	while (first_window->previous_window)
+	  first_window = first_window->previous_window;
+	gxgraph_memstats_print (stdout, dataset_table, first_window);
+	fflush (stdout);
+      }
+      break;
     }
   return 1;
 }
@@ -524,32 +810,14 @@ cb_about_dialog (GtkObject * widget, gpointer user_data)
   return 0;
 }
 
+/* The drawing callbacks just pass everything on to the cairo painter,
+   so that the screen and the exported files are drawn by the same code. */
 static void
 gtk_painter_set_attributes_style (painter_t * painter, int style)
 {
-  char *color_name;
-  GdkColor color;
-  int line_width;
-  int line_style = 0;
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
 
-  switch (style)
-    {
-    case L_AXIS:
-      color_name = "black";
-      line_width = 1;
-      break;
-    case L_GRID:
-      color_name = "gray80";
-      line_width = 1;
-      break;
-    case L_ZERO:
-      color_name = "white";
-      line_width = 2;
-      break;
-    }
-  gdk_color_parse (color_name, &color);
-  gtk_painter_set_attributes (painter,
-			      color, line_width, line_style, 0, 1.0, 1.0);
+  cp->set_attributes_style (cp, style);
 }
 
 static void
@@ -560,103 +828,35 @@ gtk_painter_set_attributes (painter_t * painter,
 			    gint mark_type,
 			    gdouble mark_size_x, gdouble mark_size_y)
 {
-  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
-  cairo_set_line_width(gtk_painter->cr, line_width);
-  cairo_set_line_cap(gtk_painter->cr, CAIRO_LINE_CAP_ROUND);
-  gdk_cairo_set_source_color(gtk_painter->cr, &color);
-  gtk_painter->current_line_style = line_style;
-
-  gtk_painter->current_mark_type = mark_type;
-  gtk_painter->current_mark_size_x = mark_size_x;
-  gtk_painter->current_mark_size_y = mark_size_y;
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
+
+  cp->set_attributes (cp, color, line_width, line_style,
+		      mark_type, mark_size_x, mark_size_y);
 }
 
 static void
 gtk_painter_draw_line (painter_t * painter,
 		       double x1, double y1, double x2, double y2)
 {
-  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
 
-  cairo_move_to(gtk_painter->cr, x1,y1);
-  cairo_line_to(gtk_painter->cr, x2,y2);
-  cairo_stroke(gtk_painter->cr);
+  cp->draw_line (cp, x1, y1, x2, y2);
 }
 
 static void
 gtk_painter_draw_segments (painter_t * painter, GArray * segments)
 {
-  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
-  seg_t *segs = (seg_t *) segments->data;
-  int seg_idx;
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
 
-  // Translate segments to gtk segments just by rounding
-  for (seg_idx = 0; seg_idx < segments->len; seg_idx++)
-    {
-      cairo_move_to(gtk_painter->cr, segs[seg_idx].x1,segs[seg_idx].y1);
-      cairo_line_to(gtk_painter->cr, segs[seg_idx].x2,segs[seg_idx].y2);
-    }
-  cairo_stroke(gtk_painter->cr);
-}
-
-static void
-draw_one_mark (GdkWindow * drawable,
-               cairo_t *cr,
-	       int x, int y,
-               int mark_type,
-               double size_x,
-               double size_y,
-               gboolean *need_stroke,
-               gboolean *need_fill)
-{
-  double rx=size_x/2, ry=size_y/2; // Mark size
-  if (mark_type == MARK_TYPE_CIRCLE) {
-    cairo_move_to(cr, x+rx,y);
-    cairo_arc(cr,
-              x, y,
-              rx, 0.0, 2*G_PI);
-    *need_stroke = 1;
-  }
-  else if (mark_type == MARK_TYPE_FCIRCLE) {
-    cairo_move_to(cr, x+rx,y);
-    cairo_arc(cr,
-              x, y,
-              rx, 0.0, 2*G_PI);
-    *need_fill = 1;
-  }
-  else if (mark_type == MARK_TYPE_SQUARE) {
-    cairo_move_to(cr, x-rx,y-ry);
-    cairo_rectangle(cr, x-rx,y-ry,2*rx,2*ry);
-    *need_stroke = 1;
-  }
-  else if (mark_type == MARK_TYPE_FSQUARE) {
-    cairo_rectangle(cr, x-rx,y-ry,2*rx,2*ry);
-    *need_fill = 1;
-  }
+  cp->draw_segments (cp, segments);
 }
 
 static void
 gtk_painter_draw_marks (painter_t * painter, GArray * marks_array)
 {
-  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
-  mark_t *marks = (mark_t *) marks_array->data;
-  int m_idx;
-  gboolean need_stroke = FALSE;
-  gboolean need_fill = FALSE;
-
-  for (m_idx = 0; m_idx < marks_array->len; m_idx++)
-    draw_one_mark (gtk_painter->pixmap,
-		   gtk_painter->cr,
-		   marks[m_idx].x,
-		   marks[m_idx].y,
-		   gtk_painter->current_mark_type,
-		   gtk_painter->current_mark_size_x,
-		   gtk_painter->current_mark_size_y,
-                   &need_stroke,
-                   &need_fill);
-  if (need_stroke)
-    cairo_stroke(gtk_painter->cr);
-  if (need_fill)
-    cairo_fill(gtk_painter->cr);
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
+
+  cp->draw_marks (cp, marks_array);
 }
 
 static void
@@ -664,50 +864,18 @@ gtk_painter_draw_text (struct painter_t_struct *painter,
 		       double x_pos, double y_pos,
 		       const char *text, int just, int style)
 {
-  gtk_painter_t *gtk_painter = (gtk_painter_t *) painter;
-  double text_size = 8;
-  GdkColor gc_black = { 0, 0, 0, 0 };
-  int layout_width, layout_height;
-  PangoRectangle log_rect, ink_rect;
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
 
-  // This should be more configurable...
-  if (style == T_TITLE)
-    text_size = 18;
-
-  pango_font_description_set_size (gtk_painter->pango_font_description,
-				   (int) (text_size) * PANGO_SCALE);
-  pango_context_set_font_description (gtk_painter->pango_context,
-				      gtk_painter->pango_font_description);
-
-  pango_layout_set_text (gtk_painter->pango_layout, text, -1);
-
-  pango_layout_get_pixel_extents (gtk_painter->pango_layout,
-				  &ink_rect, &log_rect);
-  layout_width = log_rect.width;
-  layout_height = log_rect.height;
-
-  gdk_cairo_set_source_color(gtk_painter->cr, &gc_black);
-
-  if (just == T_RIGHT)
-    {
-      x_pos -= layout_width;
-      y_pos -= layout_height / 2;
-    }
-  else if (just == T_LOWERLEFT)
-    y_pos -= layout_height;
-  else if (just == T_UPPERLEFT)
-    y_pos -= 0;
-  else if (just == T_BOTTOM)
-    {
-      y_pos -= layout_height;
-      x_pos -= layout_width / 2;
-    }
-  else if (just == T_TOP)
-    x_pos -= layout_width / 2;
+  cp->draw_text (cp, x_pos, y_pos, text, just, style);
+}
 
+static void
+gtk_painter_get_text_size (painter_t * painter, const char *text,
+			   int style, int *width, int *height)
+{
+  painter_t *cp = ((gtk_painter_t *) painter)->cairo_painter;
 
-  cairo_move_to(gtk_painter->cr,x_pos,y_pos);
-  pango_cairo_show_layout(gtk_painter->cr,gtk_painter->pango_layout);
+  cp->get_text_size (cp, text, style, width, height);
 }
 
 void
@@ -11,5 +11,10 @@
 
 painter_t *gtk_painter_new (window_t * window);
 void gtk_painter_delete (painter_t * painter);
+glong gtk_painter_get_memory_size (painter_t * painter);
+void gtk_painter_redraw (window_t * window, GPtrArray * datasets,
+			 world_t * world);
+gboolean gtk_painter_draw_appended (window_t * window);
+gboolean gtk_painter_scroll (window_t * window);
 
 #endif /* GTKPAINTER */
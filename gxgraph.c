@@ -3,6 +3,7 @@
 //----------------------------------------------------------------------
 */
 #include <math.h>
+#include <float.h>
 #include <gdk/gdktypes.h>
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
@@ -11,8 +12,23 @@
 #include <malloc.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef G_OS_WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 #include "gxgraph.h"
 #include "gtk_painter.h"
+#include "svg_painter.h"
+#include "gxgraph_export.h"
+#include "gxgraph_trace.h"
+#include "null_painter.h"
+#include "gxgraph_memstats.h"
+#include "gxgraph_arena.h"
+#include "gxgraph_spill.h"
+#include "gxgraph_pyramid.h"
+#include "gxgraph_listen.h"
+#include "gxgraph_follow.h"
+#include "gxgraph_server.h"
 #include "parser.h"
 
 #ifndef HUGE
@@ -22,18 +38,18 @@
 #define MAXBUFSIZE 1024
 
 void die (const char *fmt, ...);
-static void read_data_sets (int argp, char *argv[]);
 window_t *new_window (window_t * previous_window);
-static void put_datasets_in_window (dataset_t * datasets,
-				    window_t * window, world_t * world);
-static void gxgraph_init();
-void gxgraph_draw_title (window_t * window, painter_t * painter);
-void gxgraph_draw_legend (window_t * window, painter_t * painter);
-void gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter);
-void gxgraph_draw_data (window_t * window, painter_t * painter);
-int compute_transform (window_t * window, painter_t * painter);
-double step_grid ();
-double init_grid (double low, double step, int logFlag);
+#ifndef GXGRAPH_NO_MAIN
+static int export_data_sets (const char *output_filename,
+			     int argc, char *argv[]);
+static int run_batch (const char *batch_filename, int num_jobs);
+static int count_data_sets (int argc, char *argv[]);
+static gboolean is_headless_command_line (int argc, char *argv[]);
+static gboolean cb_print_memstats (gpointer user_data);
+#endif
+static GArray *grid_ticks_new (double low, double high, double step,
+			       int logFlag);
+static int axis_exponent (double v0, double v1, gboolean do_log);
 double round_Up (double val);
 void write_value (char *str,	/* String to write into */
 		  double val,	/* Value to print       */
@@ -59,7 +75,7 @@ enum {
   
 /* Global variables */
 window_t *first_window;
-dataset_t *first_dataset = NULL;
+GPtrArray *dataset_table = NULL;
 
 /* Global parameter values */
 gboolean  prm_do_draw_ticks = FALSE;
@@ -89,6 +105,22 @@ gboolean prm_do_logy = FALSE;
 GArray *prm_override_names = NULL;
 gint prm_requested_width = 600;
 gint prm_requested_height = 600;
+gchar *prm_output_filename = NULL;
+gchar *prm_batch_filename = NULL;
+gint prm_num_jobs = 1;
+gint prm_tile_height = 0;
+gchar *prm_painter_name = NULL;
+gboolean prm_do_memstats = FALSE;
+gint prm_storage = STORAGE_DOUBLE;
+gsize prm_mem_budget = 0;
+gchar *prm_listen_path = NULL;
+gboolean prm_do_follow = FALSE;
+gdouble prm_max_redraw_rate = 30;
+gdouble prm_strip_width = 0;
+gchar *prm_server_path = NULL;
+
+/* Bytes of points kept in memory, compared with prm_mem_budget */
+static gsize resident_point_bytes = 0;
 
 GdkColor set_colors[] = { {0, 0xffff, 0, 0},
 {0, 0, 0xffff, 0},
@@ -101,12 +133,32 @@ gint nset_colors = 6;
 
 #define CASE(s) if (strcmp(s, S_) == 0)
 
+#ifndef GXGRAPH_NO_MAIN
 int
 main (int argc, char *argv[])
 {
   int argp = 1;
-  gtk_init (&argc, &argv);
+  gboolean do_headless = is_headless_command_line (argc, argv);
+  gboolean has_display = FALSE;
+
+#if !GLIB_CHECK_VERSION(2,32,0)
+  g_thread_init (NULL);
+#endif
+
+  /* Exporting to a file never needs a display */
+  if (do_headless)
+    {
+#if !GLIB_CHECK_VERSION(2,36,0)
+      g_type_init ();
+#endif
+    }
+  else
+    has_display = gtk_init_check (&argc, &argv);
   gxgraph_init();
+
+  /* A trace that was asked for in the environment is optional */
+  if (g_getenv ("GXGRAPH_TRACE"))
+    gxgraph_trace_open (g_getenv ("GXGRAPH_TRACE"));
   
   /* Parse the rest of the command line */
   while (argp < argc && (argv[argp][0] == '-' || argv[argp][0] == '='))
@@ -120,7 +172,78 @@ main (int argc, char *argv[])
 		  "Syntax:\n"
 		  "    gxgraph [-P] [-nl] [-t t] [-xfmt xfmt] [-yfmt yfmt]\n"
 		  "            [-lnx] [-lny] [-0 0-name] [-1 1-name] ...\n"
-		  "            =WxH data1 data2 data3\n");
+		  "            [-svg_precision digits]\n"
+		  "            [-o out.{png,pdf,svg,ps,eps}] [-size WxH]\n"
+		  "            [-batch jobfile] [-j N] [-lod dpi] [-tile H]\n"
+		  "            [-trace trace.json] [-painter {null,counts}]\n"
+		  "            [-memstats]\n"
+		  "            [-compact] [-membudget MB]\n"
+		  "            [-listen path] [-follow] [-rate Hz] [-strip dx]\n"
+		  "            [-server path]\n"
+		  "            =WxH data1 data2 data3\n"
+		  "    gxgraph -client path [-o out] [-size WxH] data1 ...\n"
+		  "\n"
+		  "With -o the data is rendered to the file without opening\n"
+		  "a window or needing a display. A job file for -batch\n"
+		  "contains one plot per line as:\n"
+		  "    out.png [-size WxH] data1 data2 ...\n"
+		  "and -j runs up to N of these jobs in parallel. -lod dpi\n"
+		  "decimates the exported data to one primitive per device\n"
+		  "pixel at the given resolution. -tile H renders PNG images\n"
+		  "in bands of H rows on N threads and streams them to disk.\n"
+		  "Very large PNG images are always rendered in bands.\n"
+		  "\n"
+		  "-trace, or the GXGRAPH_TRACE environment variable, writes\n"
+		  "the time spent in each stage in the Chrome trace format.\n"
+		  "-painter null draws with a painter that only counts the\n"
+		  "drawing operations and prints a summary of them.\n"
+		  "-painter counts prints the same without the time, so\n"
+		  "that it can be compared between runs.\n"
+		  "-memstats prints the memory held by each dataset and\n"
+		  "window after loading. Press 'm' in a window for the same.\n"
+		  "Press 'F' in a window to show the time and the number of\n"
+		  "primitives of the last drawing.\n"
+		  "-lnx and -lny draw the x and y axes in a log scale. Points\n"
+		  "that aren't positive on a log axis break the lines. Press\n"
+		  "'x' or 'y' in a window to toggle the scale of an axis.\n"
+		  "\n"
+		  "-compact stores the points as floats relative to the first\n"
+		  "point of their dataset, which halves their memory. The\n"
+		  "directive $precision float does the same for one dataset.\n"
+		  "Points beyond -membudget megabytes, by default half of the\n"
+		  "physical memory, are kept in temporary files that are\n"
+		  "mapped into memory. Zero turns this off.\n"
+		  "The directive $ring n keeps only the last n points of a\n"
+		  "dataset, which suits live data that never stops.\n"
+		  "\n"
+		  "-listen path receives data while the window is shown,\n"
+		  "from producers that connect to the Unix domain socket\n"
+		  "created at path, or that write to the FIFO at path. The\n"
+		  "data is in the same format as the data files. A line\n"
+		  "naming a set switches to the set of that name, and\n"
+		  "creates it if needed. Points may also be sent in binary\n"
+		  "frames of the bytes \"\\0GXB\", a 32 bit number of points\n"
+		  "and a 32 bit name length, the set name, and the x and y\n"
+		  "doubles of the points, in the byte order of the host.\n"
+		  "-follow reads the data files as they are written, and\n"
+		  "shows the lines appended to them. A file that is\n"
+		  "truncated or replaced is read again from the start.\n"
+		  "The window is redrawn with new data at most -rate times\n"
+		  "a second, by default 30.\n"
+		  "-strip dx shows only the last dx of x, and slides along\n"
+		  "with the newest points like the trace of a scope. The\n"
+		  "window is then scrolled instead of redrawn, as long as x\n"
+		  "increases within each set and the y axis doesn't change.\n"
+		  "\n"
+		  "-server path keeps running and plots the data sent by\n"
+		  "gxgraph -client path, which connects to the Unix domain\n"
+		  "socket created at path. Each client gets a new window, or\n"
+		  "its plot is rendered to the file given with -o. The data\n"
+		  "files are read by the server, which keeps them parsed\n"
+		  "until they are modified. A client without data files\n"
+		  "sends its standard input. The options given to the\n"
+		  "server apply to all the plots, and a client may only\n"
+		  "give -o and -size.\n");
 	  exit (0);
 	};
       CASE ("-P")
@@ -160,6 +283,111 @@ main (int argc, char *argv[])
 	  prm_do_logy = TRUE;
 	  continue;
 	}
+      CASE ("-o")
+	{
+	  prm_output_filename = argv[argp++];
+	  continue;
+	}
+      CASE ("-size")
+	{
+	  if (sscanf (argv[argp++], "%dx%d",
+		      &prm_requested_width, &prm_requested_height) != 2)
+	    die ("Size should be given as WxH!\n");
+	  continue;
+	}
+      CASE ("-batch")
+	{
+	  prm_batch_filename = argv[argp++];
+	  continue;
+	}
+      CASE ("-j")
+	{
+	  prm_num_jobs = atoi (argv[argp++]);
+	  if (prm_num_jobs < 1)
+	    prm_num_jobs = 1;
+	  continue;
+	}
+      CASE ("-compact")
+	{
+	  prm_storage = STORAGE_FLOAT;
+	  continue;
+	}
+      CASE ("-membudget")
+	{
+	  prm_mem_budget = (gsize) (atof (argv[argp++]) * 1024 * 1024);
+	  continue;
+	}
+      CASE ("-listen")
+	{
+	  prm_listen_path = argv[argp++];
+	  continue;
+	}
+      CASE ("-follow")
+	{
+	  prm_do_follow = TRUE;
+	  continue;
+	}
+      CASE ("-rate")
+	{
+	  prm_max_redraw_rate = atof (argv[argp++]);
+	  continue;
+	}
+      CASE ("-server")
+	{
+	  prm_server_path = argv[argp++];
+	  continue;
+	}
+      CASE ("-client")
+	{
+	  /* The rest of the command line is sent to the server */
+	  if (argp == argc)
+	    die ("-client needs the path of the server socket!\n");
+	  return gxgraph_client_run (argv[argp], argc - argp - 1,
+				     &argv[argp + 1]);
+	}
+      CASE ("-strip")
+	{
+	  prm_strip_width = atof (argv[argp++]);
+	  if (prm_strip_width <= 0)
+	    die ("The -strip width should be positive!\n");
+	  continue;
+	}
+      CASE ("-memstats")
+	{
+	  prm_do_memstats = TRUE;
+	  continue;
+	}
+      CASE ("-painter")
+	{
+	  prm_painter_name = argv[argp++];
+	  if (strcmp (prm_painter_name, "null") != 0
+	      && strcmp (prm_painter_name, "counts") != 0)
+	    die ("Unknown painter %s!\n", prm_painter_name);
+	  continue;
+	}
+      CASE ("-trace")
+	{
+	  char *trace_filename = argv[argp++];
+
+	  if (gxgraph_trace_open (trace_filename) != 0)
+	    die ("Couldn't write the trace to %s!\n", trace_filename);
+	  continue;
+	}
+      CASE ("-tile")
+	{
+	  prm_tile_height = atoi (argv[argp++]);
+	  continue;
+	}
+      CASE ("-lod")
+	{
+	  gxgraph_export_set_lod_dpi (atof (argv[argp++]));
+	  continue;
+	}
+      CASE ("-svg_precision")
+	{
+	  svg_painter_set_default_precision (atoi (argv[argp++]));
+	  continue;
+	}
       CASE ("-bar")
 	{
 	  die ("Sorry! Bar graphs are not supported yet in gxgraph.\n");
@@ -246,19 +474,104 @@ main (int argc, char *argv[])
       die ("Unknown option %s!\n", S_);
     }
 
-  /* Get filename */
-  read_data_sets (argc - argp, &argv[argp]);
+  /* Batch jobs are already run in parallel */
+  gxgraph_export_set_tiling (prm_tile_height,
+			     prm_batch_filename ? 1 : prm_num_jobs);
+
+  if (prm_server_path)
+    {
+      if (argp < argc)
+	die ("The data files should be given to gxgraph -client!\n");
+      if (!gxgraph_server_start (prm_server_path, has_display))
+	die ("Couldn't serve on %s!\n", prm_server_path);
+      if (has_display)
+	gtk_main ();
+      else
+	g_main_loop_run (g_main_loop_new (NULL, FALSE));
+      return 0;
+    }
+
+  if (prm_batch_filename)
+    return run_batch (prm_batch_filename, prm_num_jobs);
+
+  if (prm_output_filename)
+    return export_data_sets (prm_output_filename, argc - argp, &argv[argp]);
+
+  if (prm_painter_name)
+    return count_data_sets (argc - argp, &argv[argp]);
+
+  /* Get filename. Listening replaces reading stdin. */
+  if (prm_do_follow)
+    {
+      if (argp == argc)
+	die ("-follow needs the files to follow!\n");
+      gxgraph_follow_start (argc - argp, &argv[argp]);
+    }
+  else if (!prm_listen_path || argp < argc)
+    read_data_sets (argc - argp, &argv[argp]);
+
+  if (!has_display)
+    die ("Couldn't open the display!\n");
+
+  if (prm_listen_path && !gxgraph_listen_start (prm_listen_path))
+    die ("Couldn't listen for data on %s!\n", prm_listen_path);
 
   first_window = new_window (NULL);
-  put_datasets_in_window (first_dataset, first_window, NULL);
+  put_datasets_in_window (dataset_table, first_window, NULL);
+
+  /* Wait until the window has its backing store */
+  if (prm_do_memstats)
+    g_idle_add (cb_print_memstats, NULL);
 
   gtk_main ();
 
+  if (prm_listen_path)
+    gxgraph_listen_stop ();
+  if (prm_do_follow)
+    gxgraph_follow_stop ();
+
   return 0;
 }
 
-static void gxgraph_init()
+static gboolean
+cb_print_memstats (gpointer user_data)
+{
+  gxgraph_memstats_print (stdout, dataset_table, first_window);
+  fflush (stdout);
+
+  return FALSE;
+}
+
+/* Check whether we were asked to export instead of opening a window.
+   This must be known before gtk is initialized. */
+static gboolean
+is_headless_command_line (int argc, char *argv[])
+{
+  int argp;
+
+  for (argp = 1; argp < argc; argp++)
+    if (strcmp (argv[argp], "-o") == 0
+	|| strcmp (argv[argp], "-batch") == 0
+	|| strcmp (argv[argp], "-painter") == 0
+	|| strcmp (argv[argp], "-client") == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+#endif /* GXGRAPH_NO_MAIN */
+
+void
+gxgraph_init ()
 {
+#if defined(G_OS_UNIX) && defined(_SC_PHYS_PAGES)
+  /* By default points beyond half of the memory go to spill files */
+  long num_pages = sysconf (_SC_PHYS_PAGES);
+
+  if (num_pages > 0)
+    prm_mem_budget = (gsize) num_pages * sysconf (_SC_PAGE_SIZE) / 2;
+#endif
+
   prm_title_text = g_strdup("gxgraph");
   prm_x_unit_text = g_strdup("X");
   prm_y_unit_text = g_strdup("Y");
@@ -267,12 +580,28 @@ static void gxgraph_init()
 }
 
 static dataset_t *
-new_dataset (int set_idx, const char *filename)
+new_dataset (int set_idx, const char *filename, gxgraph_arena_t * arena)
 {
   dataset_t *dataset_p = (dataset_t *) g_malloc (sizeof (dataset_t));
-
-  dataset_p->points = g_array_new (FALSE, FALSE, sizeof (point_t));
-  dataset_p->next_dataset = NULL;
+  char path_name[32];
+
+  dataset_p->storage = prm_storage;
+  dataset_p->origin_x = dataset_p->origin_y = 0;
+  dataset_p->step_x = 0;
+  dataset_p->points = g_array_new (FALSE, FALSE,
+				   prm_storage == STORAGE_FLOAT
+				   ? sizeof (compact_point_t)
+				   : sizeof (point_t));
+  dataset_p->text_marks = NULL;
+  dataset_p->spill = NULL;
+  dataset_p->spill_data = NULL;
+  dataset_p->num_spill_points = 0;
+  dataset_p->ring_capacity = dataset_p->ring_start = 0;
+  dataset_p->pyramid = NULL;
+  dataset_p->has_bbox = dataset_p->has_log_bbox = FALSE;
+  dataset_p->is_live = FALSE;
+  dataset_p->is_sorted_x = TRUE;
+  dataset_p->last_x = -HUGE_VAL;
   dataset_p->do_draw_marks = DEFAULT;
   dataset_p->do_draw_lines = DEFAULT;
   dataset_p->do_draw_polygon = FALSE;
@@ -284,431 +613,1921 @@ new_dataset (int set_idx, const char *filename)
   dataset_p->line_width = 1;
   dataset_p->text_size = 12;
 
+  /* All strings of the dataset are owned by the arena of the load */
+  dataset_p->arena = gxgraph_arena_ref (arena);
   dataset_p->set_name = NULL;
   if (prm_override_names)
     dataset_p->set_name = g_array_index (prm_override_names, char *, set_idx);
-  if (!dataset_p->set_name)
-    dataset_p->set_name = g_strdup (filename);
-  dataset_p->path_name = g_strdup_printf ("Dataset %d", num_datasets);
+  dataset_p->set_name = gxgraph_arena_strdup (arena,
+					      dataset_p->set_name
+					      ? dataset_p->set_name
+					      : filename);
+  g_snprintf (path_name, sizeof (path_name), "Dataset %d", set_idx);
+  dataset_p->path_name = gxgraph_arena_strdup (arena, path_name);
+  dataset_p->file_name = NULL;
   dataset_p->tree_path_string = NULL;
   dataset_p->is_visible = TRUE;
 
   return dataset_p;
 }
 
+static gsize
+dataset_resident_bytes (dataset_t * dataset)
+{
+  if (!dataset->points)
+    return 0;
+
+  return (gsize) dataset->points->len
+    * g_array_get_element_size (dataset->points);
+}
+
 static void
 delete_dataset (dataset_t * dataset_p)
 {
-  g_array_free (dataset_p->points, TRUE);
-  free (dataset_p);
+  resident_point_bytes -= MIN (resident_point_bytes,
+			       dataset_resident_bytes (dataset_p));
+  if (dataset_p->points)
+    g_array_free (dataset_p->points, TRUE);
+  if (dataset_p->spill)
+    gxgraph_spill_unref (dataset_p->spill);
+  if (dataset_p->pyramid)
+    gxgraph_pyramid_free (dataset_p->pyramid);
+  if (dataset_p->text_marks)
+    g_ptr_array_free (dataset_p->text_marks, TRUE);
+  gxgraph_arena_unref (dataset_p->arena);
+  g_free (dataset_p);
 }
 
+/* Move the points of a dataset that is being read to a spill file.
+   The points that follow are written to the file. */
 static void
-read_data_sets (int argc, char *argv[])
+dataset_spill (dataset_t * dataset)
 {
-  gboolean is_new_set;
-  FILE *IN;
-  dataset_t *previous_dataset = NULL;
-  dataset_t *dataset_p = first_dataset;
-  int argp = 0;
-  int linenum = 0;
-  double min_x = HUGE_VAL;
-  double max_x = 0;
-  double min_y = HUGE_VAL;
-  double max_y = 0;
-  gboolean do_stdin = argc == 0;
+  gsize element_size = g_array_get_element_size (dataset->points);
+  gxgraph_spill_t *spill = gxgraph_spill_new (element_size);
+  guint idx;
 
-  while (argp < argc || do_stdin)
+  if (!spill)
     {
-      char *filename;
-
-      if (do_stdin)
-	{
-	  IN = stdin;
-	  filename = "(stdin)";
-	}
-      else
-	{
-	  filename = argv[argp++];
-	  IN = fopen (filename, "r");
-	}
-
-      if (!IN)
-	{
-	  fprintf (stderr, "Warning! Couldn't open %s!\n", filename);
-	  continue;
-	}
-
-      is_new_set = TRUE;
-      while (!feof (IN))
-	{
-	  char S_[256];
-	  char dummy[256];
-	  gint type;
-	  point_t p;
-
-	  linenum++;
-	  fgets (S_, sizeof (S_), IN);
-	  if (is_new_set)
-	    {
-	      dataset_p = new_dataset (num_datasets, filename);
-
-	      dataset_p->color = set_colors[num_datasets % nset_colors];
-	      dataset_p->file_name = g_strdup (filename);
-
-	      if (!first_dataset)
-		first_dataset = dataset_p;
-	      if (previous_dataset)
-		previous_dataset->next_dataset = dataset_p;
-	      previous_dataset = dataset_p;
-
-	      is_new_set = FALSE;
-	      num_datasets++;
-	    }
-
-
-	  if (strlen (S_) == 1)
-	    {
-	      if (dataset_p && ((GArray *) dataset_p->points)->len > 0)
-		is_new_set++;
-	      continue;
-	    }
-
-
-#if 0
-	  sscanf (line, "%lf %lf\n", &point.x, &point.y);
-	  if (dataset_p->num_points >= dataset_p->num_alloc_points)
-	    grow_dataset (dataset_p);
-
-	  dataset_p->points[dataset_p->num_points] = point;
-	  dataset_p->num_points++;
-#endif
-
-	  /* Parse the line */
-	  type = gxgraph_parse_string (S_, filename, linenum);
-	  switch (type)
-	    {
-	    case STRING_COMMENT:
-	      break;
-	    case STRING_DRAW:
-	    case STRING_MOVE:
-	      if (type == STRING_DRAW)
-		{
-		  sscanf (S_, "%lf %lf", &p.data.point.x, &p.data.point.y);
-		  p.op = OP_DRAW;
-		}
-	      else
-		{
-		  sscanf (S_, "%s %lf %lf", dummy, &p.data.point.x,
-			  &p.data.point.y);
-		  p.op = OP_MOVE;
-		}
-
-	      /* Find marks bounding box */
-	      if (p.data.point.x < min_x)
-		min_x = p.data.point.x;
-	      else if (p.data.point.x > max_x)
-		max_x = p.data.point.x;
-	      if (p.data.point.y < min_y)
-		min_y = p.data.point.y;
-	      else if (p.data.point.y > max_y)
-		max_y = p.data.point.y;
-
-	      g_array_append_val (dataset_p->points, p);
-	      break;
-	    case STRING_TEXT:
-	      {
-		text_mark_t *tm = (text_mark_t *) g_new (text_mark_t, 1);
-		sscanf (S_, "%s %lf %lf", dummy, &tm->x, &tm->y);
-		tm->string = string_strdup_rest (S_, 3);
-		p.op = OP_TEXT;
-		p.data.point.x = tm->x;
-		p.data.point.y = tm->y;
-		p.data.text_object = tm;
-		g_array_append_val (dataset_p->points, p);
-	      }
-	      break;
-	    case STRING_CHANGE_LINE_WIDTH:
-	      dataset_p->line_width = string_to_atof (S_, 1);
-	      break;
-#if 0
-	      /* Currently no support for images */
-	    case STRING_IMAGE_REFERENCE:
-	      {
-		char *image_filename = string_strdup_word (S_, 1);
-
-		/* Todo: Make image relative to the marks list */
-		add_filename_to_image_list (image_filename,
-					    image_file_name_list);
-	      }
-	      free (image_filename);
-	      break;
-	    case STRING_MARKS_REFERENCE:
-	      {
-		char *marks_filename = string_strdup_word (S_, 1);
-
-		/* Todo: Make image relative to the marks list */
-		g_ptr_array_add (mark_file_name_list, marks_filename);
+      fprintf (stderr, "Warning! Keeping all the points in memory.\n");
+      prm_mem_budget = 0;
+      return;
+    }
 
-		break;
-	      }
-	    case STRING_LOW_CONTRAST:
-	      {
-		giv_current_transfer_function = TRANS_FUNC_LOW_CONTRAST;
-		break;
-	      }
-#endif
-	    case STRING_CHANGE_NO_LINE:
-	      dataset_p->do_draw_lines = FALSE;
-	      break;
-	    case STRING_CHANGE_POLYGON:
-	      dataset_p->do_draw_polygon = TRUE;
-	      break;
-	    case STRING_CHANGE_LINE:
-	      dataset_p->do_draw_lines = TRUE;
-	      break;
-	    case STRING_CHANGE_NO_MARK:
-	      dataset_p->do_draw_marks = FALSE;
-	      break;
-	    case STRING_CHANGE_MARK_SIZE:
-	      dataset_p->mark_size = string_to_atof (S_, 1);
-	      break;
-	    case STRING_CHANGE_TEXT_SIZE:
-	      dataset_p->text_size = string_to_atof (S_, 1);
-	      break;
-	    case STRING_CHANGE_COLOR:
-	      {
-		char *color_name = string_strdup_word (S_, 1);
-		GdkColor color;
-		if (gdk_color_parse (color_name, &color))
-		  dataset_p->color = color;
-		g_free (color_name);
-		break;
-	      }
-	    case STRING_CHANGE_OUTLINE_COLOR:
-	      {
-		char *color_name = string_strdup_word (S_, 1);
-		GdkColor color;
-		if (gdk_color_parse (color_name, &color))
-		  dataset_p->outline_color = color;
-		dataset_p->do_draw_polygon_outline = TRUE;
-		g_free (color_name);
-		break;
-	      }
-	    case STRING_CHANGE_MARKS:
-	      {
-		char *mark_name = string_strdup_word (S_, 1);
-		dataset_p->do_draw_marks = TRUE;
+  for (idx = 0; idx < dataset->points->len; idx++)
+    {
+      point_t p = dataset_get_point (dataset, idx);
+      gboolean is_text = p.op == OP_TEXT;
+
+      if (!gxgraph_spill_append (spill,
+				 dataset->points->data + idx * element_size,
+				 is_text ? p.data.text_object->x
+				 : p.data.point.x,
+				 is_text ? p.data.text_object->y
+				 : p.data.point.y))
+	die ("Failed writing a spill file!\n");
+    }
 
-		dataset_p->mark_type =
-		  gxgraph_parse_mark_type (mark_name, filename, linenum);
+  resident_point_bytes -= MIN (resident_point_bytes,
+			       dataset_resident_bytes (dataset));
+  dataset->num_spill_points = dataset->points->len;
+  g_array_free (dataset->points, TRUE);
+  dataset->points = NULL;
+  dataset->spill = spill;
+}
 
-		g_free (mark_name);
-		break;
-	      }
-	    case STRING_CHANGE_SCALE_MARKS:
-	      if (string_count_words (S_) == 1)
-		dataset_p->do_scale_marks = 1;
-	      else
-		dataset_p->do_scale_marks = string_to_atoi (S_, 1);
-	      break;
-	    case STRING_PATH_NAME:
-	      if (dataset_p->path_name)
-		g_free (dataset_p->path_name);
-	      dataset_p->path_name = string_strdup_rest (S_, 1);
-	      break;
-	    case STRING_SET_NAME:
-	      if (dataset_p->set_name)
-		g_free (dataset_p->set_name);
-
-	      /* This is uggly. It is doing part of the parsing here...
-		 My excuse is that the xgraph syntax is really broken.
-	       */
-	      if (S_[0] == '"')
-		dataset_p->set_name = g_strdup (&S_[1]);
-	      else
-		dataset_p->set_name = string_strdup_rest(S_, 1);
-	      break;
-	    case STRING_SET_TITLE:
-              {
-                if (prm_title_text)
-                  g_free(prm_title_text);
-              
-                gchar *rest = string_strdup_rest(S_, 1);
-                string_shorten_whitespace(rest);
-                prm_title_text = g_malloc(strlen(rest));
-                gchar *p = prm_title_text;
-                int i;
-                // Erase quotes for start and end.
-                for (i=0; i<strlen(rest); i++)
-                  {
-                    if ((i==0 || i == strlen(rest)-1) && rest[i]=='"')
-                      continue;
-                    *p++ = rest[i];
-                  }
-                *p = 0;
-                g_free(rest);
-              }
-	      break;
-	    case STRING_SET_LARGE_PIXELS:
-	      default_draw_marks = TRUE;
-	      break;
-	    case STRING_SET_XUNIT_TEXT:
-	      if (prm_x_unit_text)
-		g_free(prm_x_unit_text);
-	      prm_x_unit_text = string_strdup_rest(S_, 1);
-	      break;
-	    case STRING_SET_YUNIT_TEXT:
-	      if (prm_y_unit_text)
-		g_free(prm_y_unit_text);
-	      prm_y_unit_text = string_strdup_rest(S_, 1);
-	      break;
-	    }
+/* Map the spill file of a dataset once it has been read */
+static void
+dataset_finish (dataset_t * dataset)
+{
+  if (!dataset->spill || dataset->spill_data)
+    return;
 
-	}
+  dataset->spill_data = gxgraph_spill_finish (dataset->spill);
+  if (!dataset->spill_data)
+    dataset->num_spill_points = 0;
+}
 
-      /* Get rid of empty data sets */
-      if (dataset_p && dataset_p->points->len == 0)
-	{
-	  dataset_t *ds_p;
-	  /* Search and get rid of the last dataset */
-	  for (ds_p = first_dataset; ds_p; ds_p = ds_p->next_dataset)
-	    {
-	      if (ds_p->next_dataset == dataset_p)
-		{
-		  ds_p->next_dataset = NULL;
-		  break;
-		}
-	    }
-	  num_datasets--;
+/* Put a point in the next slot of a ring dataset, over the oldest
+   point once the ring is full */
+static void
+dataset_ring_append (dataset_t * dataset, point_t * p)
+{
+  guint slot;
 
-	  delete_dataset (dataset_p);
-	}
+  if (dataset->points->len < dataset->ring_capacity)
+    {
+      slot = dataset->points->len;
+      g_array_append_vals (dataset->points, p, 1);
+      resident_point_bytes += sizeof (point_t);
+    }
+  else
+    {
+      slot = dataset->ring_start;
+      g_array_index (dataset->points, point_t, slot) = *p;
+      if (++dataset->ring_start == dataset->ring_capacity)
+	dataset->ring_start = 0;
+    }
 
-      fclose (IN);
+  /* The box of a block also holds the last point of the block before
+     it, for the line between them */
+  gxgraph_pyramid_invalidate (dataset->pyramid, slot);
+  if (((slot + 1) & (PYRAMID_BLOCK_SIZE - 1)) == 0
+      || slot + 1 == dataset->ring_capacity)
+    gxgraph_pyramid_invalidate (dataset->pyramid,
+				(slot + 1) % dataset->ring_capacity);
+}
 
-      if (do_stdin)
-          break;
+/* The coordinates of a point, also of text marks */
+static void
+point_get_xy (const point_t * p, double *x, double *y)
+{
+  if (p->op == OP_TEXT)
+    {
+      *x = p->data.text_object->x;
+      *y = p->data.text_object->y;
+    }
+  else
+    {
+      *x = p->data.point.x;
+      *y = p->data.point.y;
     }
 }
 
 static void
-put_datasets_in_window (dataset_t * datasets,
-			window_t * window, world_t * world)
+dataset_store_point (dataset_t * dataset, point_t * p)
 {
-  dataset_t *ds_p;
+  compact_point_t cp;
+  gconstpointer element = p;
+  gboolean is_text = p->op == OP_TEXT;
 
-  window->first_dataset = datasets;
-
-  if (world)
+  /* Text marks aren't kept in the order of x */
+  if (dataset->is_sorted_x)
     {
-      window->world.x0 = world->x0;
-      window->world.x1 = world->x1;
-      window->world.y0 = world->y0;
-      window->world.y1 = world->y1;
+      if (is_text || !(p->data.point.x >= dataset->last_x))
+	dataset->is_sorted_x = FALSE;
+      else
+	dataset->last_x = p->data.point.x;
     }
-  else
+
+  if (dataset->ring_capacity)
     {
-      double min_x, max_x, min_y, max_y;
-      double world_pad_x, world_pad_y;
+      dataset_ring_append (dataset, p);
+      return;
+    }
 
-      min_x = min_y = HUGE;
-      max_x = max_y = -HUGE;
+  /* Points that don't continue the uniform spacing need full storage */
+  if (dataset->storage == STORAGE_UNIFORM
+      || dataset->storage == STORAGE_UNIFORM_FLOAT)
+    {
+      double x = dataset->origin_x + dataset->points->len * dataset->step_x;
 
-      for (ds_p = datasets; ds_p; ds_p = ds_p->next_dataset)
+      if (p->op == OP_DRAW && p->data.point.x == x)
 	{
-	  int p_idx;
-	  if (!ds_p->points)
-	    continue;
-	  for (p_idx = 0; p_idx < ds_p->points->len; p_idx++)
+	  if (dataset->storage == STORAGE_UNIFORM)
+	    g_array_append_val (dataset->points, p->data.point.y);
+	  else
 	    {
-	      point_t p = g_array_index (ds_p->points, point_t, p_idx);
+	      gfloat y = p->data.point.y - dataset->origin_y;
 
-	      if (p.data.point.y < min_y)
-		min_y = p.data.point.y;
-	      if (p.data.point.y > max_y)
-		max_y = p.data.point.y;
+	      g_array_append_val (dataset->points, y);
+	    }
+	  return;
+	}
+      dataset_set_storage (dataset,
+			   dataset->storage == STORAGE_UNIFORM
+			   ? STORAGE_DOUBLE : STORAGE_FLOAT);
+    }
 
-	      if (p.data.point.x < min_x)
-		min_x = p.data.point.x;
-	      if (p.data.point.x > max_x)
-		max_x = p.data.point.x;
+  if (dataset->storage == STORAGE_FLOAT)
+    {
+      /* The first point is the origin of the rest */
+      if (dataset_get_num_points (dataset) == 0)
+	{
+	  if (is_text)
+	    {
+	      dataset->origin_x = p->data.text_object->x;
+	      dataset->origin_y = p->data.text_object->y;
+	    }
+	  else
+	    {
+	      dataset->origin_x = p->data.point.x;
+	      dataset->origin_y = p->data.point.y;
 	    }
 	}
 
-      /* Check if external paramaters are valid, then use these.
-	 If both x and y are overridden then it is a waste of
-	 time to search for the min and max above, but I am ignoring
-	 that for the moment.
-       */
-      if (prm_x_hi_limit > prm_x_low_limit)
+      cp.op = p->op;
+      if (is_text)
 	{
-	  min_x = prm_x_low_limit;
-	  max_x = prm_x_hi_limit;
+	  if (!dataset->text_marks)
+	    dataset->text_marks = g_ptr_array_new ();
+	  cp.data.text_idx = dataset->text_marks->len;
+	  g_ptr_array_add (dataset->text_marks, p->data.text_object);
 	}
-      if (prm_y_hi_limit > prm_y_low_limit)
+      else
 	{
-	  min_y = prm_y_low_limit;
-	  max_y = prm_y_hi_limit;
+	  cp.data.point.x = p->data.point.x - dataset->origin_x;
+	  cp.data.point.y = p->data.point.y - dataset->origin_y;
 	}
-      
-      /* Add 10% padding */
-      world_pad_x = (max_x - min_x) * 0.05;
-      world_pad_y = (max_y - min_y) * 0.05;
-      window->world.x0 = min_x - world_pad_x;
-      window->world.x1 = max_x + world_pad_x;
-      window->world.y0 = min_y - world_pad_y;
-      window->world.y1 = max_y + world_pad_y;
+      element = &cp;
     }
 
-  window->world.col_0 = 20;
-  window->world.scale_x =
-    1.0 * (window->width - 40) / (window->world.x1 - window->world.x0);
-  window->world.scale_y =
-    1.0 * -(window->height - 40) / (window->world.y1 - window->world.y0);
+  if (!dataset->spill && !dataset->is_live && prm_mem_budget > 0
+      && resident_point_bytes >= prm_mem_budget)
+    dataset_spill (dataset);
 
-  window->world.col_0 = 20 - window->world.x0 * window->world.scale_x;
-  gxgraph_draw_window (window, NULL);
-}
+  if (dataset->spill)
+    {
+      /* The bounding boxes are of the stored points */
+      point_t stored = *p;
 
-void
-die (const char *fmt, ...)
-{
-  va_list ap;
-  va_start (ap, fmt);
+      if (element == &cp && !is_text)
+	{
+	  stored.data.point.x = dataset->origin_x + cp.data.point.x;
+	  stored.data.point.y = dataset->origin_y + cp.data.point.y;
+	}
+      if (!gxgraph_spill_append (dataset->spill, element,
+				 is_text ? p->data.text_object->x
+				 : stored.data.point.x,
+				 is_text ? p->data.text_object->y
+				 : stored.data.point.y))
+	die ("Failed writing a spill file!\n");
+      dataset->num_spill_points++;
+      return;
+    }
 
-  vfprintf (stderr, fmt, ap);
-  exit (-1);
+  g_array_append_vals (dataset->points, element, 1);
+  resident_point_bytes += g_array_get_element_size (dataset->points);
 }
 
+/* Add a point to a dataset. The bounding boxes that are already known
+   grow with the point, so that live data is fitted without going over
+   all of its points again. */
 void
-gxgraph_add_window_with_world (window_t * previous_window, world_t * world)
+dataset_append_point (dataset_t * dataset, point_t * p)
 {
-  window_t *window = new_window (previous_window);
-  put_datasets_in_window (first_dataset, window, world);
-}
+  gboolean is_full_ring = dataset->ring_capacity
+    && dataset->points->len == dataset->ring_capacity;
+  point_t stored;
+  double x, y;
 
-window_t *
-new_window (window_t * previous_window)
-{
-  window_t *window;
+  dataset_store_point (dataset, p);
 
+  /* The point that is overwritten may have been on the boxes */
+  if (is_full_ring || dataset->spill)
+    {
+      dataset->has_bbox = dataset->has_log_bbox = FALSE;
+      return;
+    }
+  if (!dataset->has_bbox)
+    return;
+
+  /* As it was stored, which may be in float precision */
+  stored = dataset_get_point (dataset, dataset_get_num_points (dataset) - 1);
+  point_get_xy (&stored, &x, &y);
+  dataset->bbox_x0 = MIN (dataset->bbox_x0, x);
+  dataset->bbox_x1 = MAX (dataset->bbox_x1, x);
+  dataset->bbox_y0 = MIN (dataset->bbox_y0, y);
+  dataset->bbox_y1 = MAX (dataset->bbox_y1, y);
+  if (!dataset->has_log_bbox)
+    return;
+  if (x > 0)
+    {
+      dataset->log_x0 = MIN (dataset->log_x0, log10 (x));
+      dataset->log_x1 = MAX (dataset->log_x1, log10 (x));
+    }
+  if (y > 0)
+    {
+      dataset->log_y0 = MIN (dataset->log_y0, log10 (y));
+      dataset->log_y1 = MAX (dataset->log_y1, log10 (y));
+    }
+}
+
+/* Convert the points that have been read so far to STORAGE_DOUBLE or
+   STORAGE_FLOAT */
+void
+dataset_set_storage (dataset_t * dataset, gint storage)
+{
+  dataset_t old = *dataset;
+  guint idx;
+
+  if (storage == dataset->storage)
+    return;
+  if (dataset->spill)
+    {
+      fprintf (stderr, "Warning! Can't change the precision of a dataset "
+	       "that has been moved to a spill file.\n");
+      return;
+    }
+  if (dataset->ring_capacity)
+    {
+      fprintf (stderr, "Warning! Ring datasets are kept in double "
+	       "precision.\n");
+      return;
+    }
+
+  resident_point_bytes -= MIN (resident_point_bytes,
+			       dataset_resident_bytes (dataset));
+
+  dataset->storage = storage;
+  dataset->points = g_array_sized_new (FALSE, FALSE,
+				       storage == STORAGE_FLOAT
+				       ? sizeof (compact_point_t)
+				       : sizeof (point_t), old.points->len);
+  dataset->text_marks = NULL;
+  dataset->is_sorted_x = TRUE;
+  dataset->last_x = -HUGE_VAL;
+  dataset->has_bbox = dataset->has_log_bbox = FALSE;
+  for (idx = 0; idx < old.points->len; idx++)
+    {
+      point_t p = dataset_get_point (&old, idx);
+
+      dataset_append_point (dataset, &p);
+    }
+
+  g_array_free (old.points, TRUE);
+  if (old.text_marks)
+    g_ptr_array_free (old.text_marks, TRUE);
+}
+
+/* Keep only the last capacity points of a dataset, the ones that have
+   been read and the ones that follow */
+void
+dataset_set_ring (dataset_t * dataset, guint capacity)
+{
+  dataset_t old;
+  guint num_points, idx;
+
+  if (capacity == 0)
+    {
+      fprintf (stderr, "Warning! A ring must hold at least one point.\n");
+      return;
+    }
+  if (dataset->spill)
+    {
+      fprintf (stderr, "Warning! Can't make a ring of a dataset that has "
+	       "been moved to a spill file.\n");
+      return;
+    }
+
+  if (!dataset->ring_capacity)
+    dataset_set_storage (dataset, STORAGE_DOUBLE);
+  old = *dataset;
+  num_points = dataset_get_num_points (&old);
+
+  resident_point_bytes -= MIN (resident_point_bytes,
+			       dataset_resident_bytes (dataset));
+
+  dataset->points = g_array_sized_new (FALSE, FALSE, sizeof (point_t),
+				       capacity);
+  dataset->ring_capacity = capacity;
+  dataset->ring_start = 0;
+  dataset->pyramid = gxgraph_pyramid_new (capacity);
+  dataset->is_sorted_x = TRUE;
+  dataset->last_x = -HUGE_VAL;
+  dataset->has_bbox = dataset->has_log_bbox = FALSE;
+  for (idx = num_points > capacity ? num_points - capacity : 0;
+       idx < num_points; idx++)
+    {
+      point_t p = dataset_get_point (&old, idx);
+
+      dataset_append_point (dataset, &p);
+    }
+
+  g_array_free (old.points, TRUE);
+  if (old.pyramid)
+    gxgraph_pyramid_free (old.pyramid);
+}
+
+/* If the x of the points are uniformly spaced, store only the first x,
+   the spacing and the y. The spacing must be exact to within a few
+   units in the last place of x, or of the float offsets of compact
+   datasets. Returns whether the dataset was converted. */
+gboolean
+dataset_make_uniform (dataset_t * dataset)
+{
+  guint num_points = dataset_get_num_points (dataset);
+  gboolean is_float = dataset->storage == STORAGE_FLOAT;
+  point_t first, last;
+  double step_x, tolerance;
+  GArray *ys;
+  guint idx;
+
+  if ((dataset->storage != STORAGE_DOUBLE && !is_float) || num_points < 2
+      || dataset->spill || dataset->ring_capacity)
+    return FALSE;
+
+  first = dataset_get_point (dataset, 0);
+  last = dataset_get_point (dataset, num_points - 1);
+  if (first.op == OP_TEXT || last.op != OP_DRAW)
+    return FALSE;
+  step_x = (last.data.point.x - first.data.point.x) / (num_points - 1);
+  if (!(step_x > 0))
+    return FALSE;
+
+  tolerance = 8 * DBL_EPSILON * MAX (fabs (first.data.point.x),
+				     fabs (last.data.point.x));
+  if (is_float)
+    tolerance += 8 * FLT_EPSILON * fabs (last.data.point.x
+					 - dataset->origin_x);
+
+  for (idx = 1; idx < num_points; idx++)
+    {
+      point_t p = dataset_get_point (dataset, idx);
+
+      if (p.op != OP_DRAW
+	  || fabs (p.data.point.x - (first.data.point.x + idx * step_x))
+	  > tolerance)
+	return FALSE;
+    }
+
+  ys = g_array_sized_new (FALSE, FALSE,
+			  is_float ? sizeof (gfloat) : sizeof (gdouble),
+			  num_points);
+  for (idx = 0; idx < num_points; idx++)
+    {
+      if (is_float)
+	{
+	  gfloat y = g_array_index (dataset->points, compact_point_t,
+				    idx).data.point.y;
+
+	  g_array_append_val (ys, y);
+	}
+      else
+	{
+	  gdouble y = g_array_index (dataset->points, point_t,
+				     idx).data.point.y;
+
+	  g_array_append_val (ys, y);
+	}
+    }
+
+  resident_point_bytes -= MIN (resident_point_bytes,
+			       dataset_resident_bytes (dataset));
+  g_array_free (dataset->points, TRUE);
+  dataset->points = ys;
+  resident_point_bytes += dataset_resident_bytes (dataset);
+  dataset->storage = is_float ? STORAGE_UNIFORM_FLOAT : STORAGE_UNIFORM;
+  dataset->origin_x = first.data.point.x;
+  dataset->step_x = step_x;
+  dataset->has_bbox = dataset->has_log_bbox = FALSE;
+
+  return TRUE;
+}
+
+/* The index of the first point of a dataset sorted by x whose x is
+   beyond x, or at x if is_inclusive */
+static guint
+dataset_bisect_x (dataset_t * dataset, double x, gboolean is_inclusive)
+{
+  guint low = 0, high = dataset_get_num_points (dataset);
+
+  while (low < high)
+    {
+      guint mid = low + (high - low) / 2;
+      double mid_x = dataset_get_point (dataset, mid).data.point.x;
+
+      if (mid_x < x || (!is_inclusive && mid_x == x))
+	low = mid + 1;
+      else
+	high = mid;
+    }
+
+  return low;
+}
+
+/* The range of indices [*start, *end) of the points of a dataset that
+   may be visible between x0 and x1. Only uniform datasets and datasets
+   sorted by x can tell without looking at all the points. One point
+   outside on each side is included so that the lines leaving the view
+   are drawn. */
+static void
+dataset_get_visible_range (dataset_t * dataset, double x0, double x1,
+			   guint * start, guint * end)
+{
+  double first, last;
+
+  *start = 0;
+  *end = dataset_get_num_points (dataset);
+  if (*end == 0)
+    return;
+
+  if (dataset->storage != STORAGE_UNIFORM
+      && dataset->storage != STORAGE_UNIFORM_FLOAT)
+    {
+      guint num_points = *end;
+
+      if (!dataset->is_sorted_x)
+	return;
+      *start = dataset_bisect_x (dataset, x0, TRUE);
+      *end = dataset_bisect_x (dataset, x1, FALSE);
+      if (*start > 0)
+	(*start)--;
+      if (*end < num_points)
+	(*end)++;
+      return;
+    }
+
+  first = floor ((x0 - dataset->origin_x) / dataset->step_x);
+  last = ceil ((x1 - dataset->origin_x) / dataset->step_x) + 1;
+  if (first > 0)
+    *start = first < *end ? (guint) first : *end;
+  if (last < *end)
+    *end = last > *start ? (guint) last : *start;
+}
+
+/* Give the dataset the next id of the table */
+static void
+dataset_table_add (dataset_t * dataset)
+{
+  dataset->id = dataset_table->len;
+  g_ptr_array_add (dataset_table, dataset);
+}
+
+/* Delete a dataset and free its slot. Only the last slot is reused, so
+   that the ids of the others don't change. */
+void
+dataset_table_remove (dataset_t * dataset)
+{
+  window_t *window;
+  guint id = dataset->id;
+
+  delete_dataset (dataset);
+  if (id == dataset_table->len - 1)
+    g_ptr_array_set_size (dataset_table, id);
+  else
+    g_ptr_array_index (dataset_table, id) = NULL;
+
+  /* The set that reuses the slot is new to the windows */
+  for (window = first_window; window; window = window->next_window)
+    window->num_ids_seen = MIN (window->num_ids_seen, dataset_table->len);
+}
+
+/* The dataset with the given id, or NULL if it has been removed */
+dataset_t *
+dataset_table_lookup (guint id)
+{
+  if (!dataset_table || id >= dataset_table->len)
+    return NULL;
+
+  return g_ptr_array_index (dataset_table, id);
+}
+
+/* Forget all datasets that have been read */
+void
+delete_data_sets ()
+{
+  guint id;
+
+  if (dataset_table)
+    {
+      for (id = 0; id < dataset_table->len; id++)
+	if (g_ptr_array_index (dataset_table, id))
+	  delete_dataset (g_ptr_array_index (dataset_table, id));
+      g_ptr_array_set_size (dataset_table, 0);
+    }
+  num_datasets = 0;
+}
+
+/* The state of parsing one stream of the gxgraph text format */
+struct loader_t_struct
+{
+  gchar *filename;
+  gxgraph_arena_t *arena;
+  dataset_t *dataset;		/* The set that lines are added to       */
+  gboolean is_new_set;		/* Start a new set at the next line      */
+  gint linenum;
+  gboolean is_tracing_dataset;
+  GArray *set_ids;		/* The ids of the sets read              */
+  GArray *set_idxs;		/* The number of each set started, that
+				   picks its color and name. A file that
+				   is read again reuses them.            */
+  guint num_sets;		/* The sets started since the file was
+				   last read from its start              */
+
+  /* Followed files and live streams keep receiving points after the
+     window is shown. Live streams may also switch between their sets
+     by naming them. */
+  loader_mode_t mode;
+  GHashTable *live_sets;	/* Set name to dataset id                */
+};
+
+loader_t *
+loader_new (const char *filename, gxgraph_arena_t * arena,
+	    loader_mode_t mode)
+{
+  loader_t *loader = g_new0 (loader_t, 1);
+
+  if (!dataset_table)
+    dataset_table = g_ptr_array_new ();
+
+  loader->filename = g_strdup (filename);
+  loader->arena = gxgraph_arena_ref (arena);
+  loader->is_new_set = TRUE;
+  loader->set_ids = g_array_new (FALSE, FALSE, sizeof (guint));
+  loader->set_idxs = g_array_new (FALSE, FALSE, sizeof (int));
+  loader->mode = mode;
+  if (mode == LOADER_LIVE)
+    loader->live_sets = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, NULL);
+
+  return loader;
+}
+
+static void
+loader_start_set (loader_t * loader)
+{
+  dataset_t *dataset_p;
+  int set_idx;
+
+  if (loader->mode == LOADER_FILE)
+    {
+      if (loader->is_tracing_dataset)
+	TRACE_END ("parse dataset");
+      TRACE_BEGIN ("parse dataset", NULL);
+      loader->is_tracing_dataset = TRUE;
+    }
+
+  if (loader->num_sets < loader->set_idxs->len)
+    set_idx = g_array_index (loader->set_idxs, int, loader->num_sets);
+  else
+    {
+      set_idx = num_datasets++;
+      g_array_append_val (loader->set_idxs, set_idx);
+    }
+  loader->num_sets++;
+
+  dataset_p = new_dataset (set_idx, loader->filename, loader->arena);
+  dataset_p->color = set_colors[set_idx % nset_colors];
+  dataset_p->file_name = gxgraph_arena_strdup (loader->arena,
+					       loader->filename);
+  dataset_p->is_live = loader->mode != LOADER_FILE;
+  dataset_table_add (dataset_p);
+  g_array_append_val (loader->set_ids, dataset_p->id);
+
+  loader->dataset = dataset_p;
+  loader->is_new_set = FALSE;
+}
+
+/* Remove a set of the loader from the windows and the table */
+static void
+loader_remove_set (loader_t * loader, dataset_t * dataset_p)
+{
+  window_t *window;
+  guint idx;
+
+  for (idx = loader->set_ids->len; idx-- > 0;)
+    if (g_array_index (loader->set_ids, guint, idx) == dataset_p->id)
+      {
+	g_array_remove_index (loader->set_ids, idx);
+	break;
+      }
+  for (window = first_window; window; window = window->next_window)
+    if (g_ptr_array_remove (window->datasets, dataset_p)
+	&& window->num_drawn)
+      g_array_set_size (window->num_drawn, 0);
+  dataset_table_remove (dataset_p);
+}
+
+/* Get rid of the current set if nothing was put in it. Live sets may
+   already be shown in the windows. */
+static void
+loader_drop_empty_set (loader_t * loader)
+{
+  dataset_t *dataset_p = loader->dataset;
+  gboolean is_last;
+
+  if (!dataset_p || dataset_get_num_points (dataset_p) > 0)
+    return;
+
+  is_last = loader->set_ids->len > 0
+    && g_array_index (loader->set_ids, guint,
+		      loader->set_ids->len - 1) == dataset_p->id;
+  if (loader->live_sets && dataset_p->set_name)
+    g_hash_table_remove (loader->live_sets, dataset_p->set_name);
+  loader_remove_set (loader, dataset_p);
+  loader->dataset = NULL;
+
+  /* The next set takes the number of the dropped one */
+  if (!is_last)
+    return;
+  loader->num_sets--;
+  if (loader->num_sets == loader->set_idxs->len - 1
+      && g_array_index (loader->set_idxs, int, loader->num_sets)
+      == num_datasets - 1)
+    {
+      g_array_set_size (loader->set_idxs, loader->num_sets);
+      num_datasets--;
+    }
+}
+
+/* Make the set with the given name current in a live stream. A set
+   that already has points is not renamed, but followed by a new one. */
+static void
+loader_select_set (loader_t * loader, const char *set_name)
+{
+  gpointer id;
+
+  if (g_hash_table_lookup_extended (loader->live_sets, set_name, NULL, &id)
+      && dataset_table_lookup (GPOINTER_TO_UINT (id)))
+    {
+      if (loader->dataset
+	  && loader->dataset != dataset_table_lookup (GPOINTER_TO_UINT (id)))
+	loader_drop_empty_set (loader);
+      loader->dataset = dataset_table_lookup (GPOINTER_TO_UINT (id));
+      loader->is_new_set = FALSE;
+      return;
+    }
+
+  if (loader->is_new_set || dataset_get_num_points (loader->dataset) > 0)
+    loader_start_set (loader);
+  else if (loader->dataset->set_name)
+    g_hash_table_remove (loader->live_sets, loader->dataset->set_name);
+
+  loader->dataset->set_name = gxgraph_arena_strdup (loader->arena, set_name);
+  g_hash_table_insert (loader->live_sets, g_strdup (set_name),
+		       GUINT_TO_POINTER (loader->dataset->id));
+}
+
+/* Parse a line, including its newline */
+void
+loader_parse_line (loader_t * loader, const char *S_)
+{
+  dataset_t *dataset_p;
+  char dummy[256];
+  char word[256];
+  gint type;
+  point_t p;
+
+  loader->linenum++;
+
+  if (strlen (S_) == 1)
+    {
+      if (loader->dataset && !loader->is_new_set
+	  && dataset_get_num_points (loader->dataset) > 0)
+	loader->is_new_set = TRUE;
+      return;
+    }
+
+  /* Parse the line */
+  type = gxgraph_parse_string (S_, loader->filename, loader->linenum);
+
+  if (loader->mode == LOADER_LIVE && type == STRING_SET_NAME)
+    {
+      gchar *set_name = S_[0] == '"' ? g_strdup (&S_[1])
+	: string_strdup_rest (S_, 1);
+
+      g_strchomp (set_name);
+      loader_select_set (loader, set_name);
+      g_free (set_name);
+      return;
+    }
+
+  if (loader->is_new_set)
+    loader_start_set (loader);
+  dataset_p = loader->dataset;
+
+  switch (type)
+    {
+    case STRING_COMMENT:
+      break;
+    case STRING_DRAW:
+    case STRING_MOVE:
+      if (type == STRING_DRAW)
+	{
+	  sscanf (S_, "%lf %lf", &p.data.point.x, &p.data.point.y);
+	  p.op = OP_DRAW;
+	}
+      else
+	{
+	  sscanf (S_, "%s %lf %lf", dummy, &p.data.point.x, &p.data.point.y);
+	  p.op = OP_MOVE;
+	}
+
+      dataset_append_point (dataset_p, &p);
+      break;
+    case STRING_TEXT:
+      {
+	text_mark_t *tm = gxgraph_arena_alloc (loader->arena,
+					       sizeof (text_mark_t));
+	sscanf (S_, "%s %lf %lf", dummy, &tm->x, &tm->y);
+	tm->string = string_arena_strdup_rest (loader->arena, S_, 3);
+	p.op = OP_TEXT;
+	p.data.point.x = tm->x;
+	p.data.point.y = tm->y;
+	p.data.text_object = tm;
+	dataset_append_point (dataset_p, &p);
+      }
+      break;
+    case STRING_SET_PRECISION:
+      string_copy_word (S_, 1, word, sizeof (word));
+      if (g_ascii_strcasecmp (word, "float") == 0)
+	dataset_set_storage (dataset_p, STORAGE_FLOAT);
+      else if (g_ascii_strcasecmp (word, "double") == 0)
+	dataset_set_storage (dataset_p, STORAGE_DOUBLE);
+      else
+	fprintf (stderr, "Unknown precision in file %s line %d!\n",
+		 loader->filename, loader->linenum);
+      break;
+    case STRING_SET_RING:
+      dataset_set_ring (dataset_p, MAX (string_to_atoi (S_, 1), 0));
+      break;
+    case STRING_CHANGE_LINE_WIDTH:
+      dataset_p->line_width = string_to_atof (S_, 1);
+      break;
+#if 0
+      /* Currently no support for images */
+    case STRING_IMAGE_REFERENCE:
+      {
+	char *image_filename = string_strdup_word (S_, 1);
+
+	/* Todo: Make image relative to the marks list */
+	add_filename_to_image_list (image_filename, image_file_name_list);
+      }
+      free (image_filename);
+      break;
+    case STRING_MARKS_REFERENCE:
+      {
+	char *marks_filename = string_strdup_word (S_, 1);
+
+	/* Todo: Make image relative to the marks list */
+	g_ptr_array_add (mark_file_name_list, marks_filename);
+
+	break;
+      }
+    case STRING_LOW_CONTRAST:
+      {
+	giv_current_transfer_function = TRANS_FUNC_LOW_CONTRAST;
+	break;
+      }
+#endif
+    case STRING_CHANGE_NO_LINE:
+      dataset_p->do_draw_lines = FALSE;
+      break;
+    case STRING_CHANGE_POLYGON:
+      dataset_p->do_draw_polygon = TRUE;
+      break;
+    case STRING_CHANGE_LINE:
+      dataset_p->do_draw_lines = TRUE;
+      break;
+    case STRING_CHANGE_NO_MARK:
+      dataset_p->do_draw_marks = FALSE;
+      break;
+    case STRING_CHANGE_MARK_SIZE:
+      dataset_p->mark_size = string_to_atof (S_, 1);
+      break;
+    case STRING_CHANGE_TEXT_SIZE:
+      dataset_p->text_size = string_to_atof (S_, 1);
+      break;
+    case STRING_CHANGE_COLOR:
+      {
+	GdkColor color;
+
+	string_copy_word (S_, 1, word, sizeof (word));
+	if (gdk_color_parse (word, &color))
+	  dataset_p->color = color;
+	break;
+      }
+    case STRING_CHANGE_OUTLINE_COLOR:
+      {
+	GdkColor color;
+
+	string_copy_word (S_, 1, word, sizeof (word));
+	if (gdk_color_parse (word, &color))
+	  dataset_p->outline_color = color;
+	dataset_p->do_draw_polygon_outline = TRUE;
+	break;
+      }
+    case STRING_CHANGE_MARKS:
+      string_copy_word (S_, 1, word, sizeof (word));
+      dataset_p->do_draw_marks = TRUE;
+      dataset_p->mark_type =
+	gxgraph_parse_mark_type (word, loader->filename, loader->linenum);
+      break;
+    case STRING_CHANGE_SCALE_MARKS:
+      if (string_count_words (S_) == 1)
+	dataset_p->do_scale_marks = 1;
+      else
+	dataset_p->do_scale_marks = string_to_atoi (S_, 1);
+      break;
+    case STRING_PATH_NAME:
+      dataset_p->path_name = string_arena_strdup_rest (loader->arena, S_, 1);
+      break;
+    case STRING_SET_NAME:
+      /* This is uggly. It is doing part of the parsing here...
+	 My excuse is that the xgraph syntax is really broken.
+       */
+      if (S_[0] == '"')
+	dataset_p->set_name = gxgraph_arena_strdup (loader->arena, &S_[1]);
+      else
+	dataset_p->set_name = string_arena_strdup_rest (loader->arena, S_, 1);
+      break;
+    case STRING_SET_TITLE:
+      {
+	gchar *rest = string_strdup_rest (S_, 1);
+	gchar *p;
+	int i;
+
+	if (prm_title_text)
+	  g_free (prm_title_text);
+
+	string_shorten_whitespace (rest);
+	prm_title_text = g_malloc (strlen (rest) + 1);
+	p = prm_title_text;
+	// Erase quotes for start and end.
+	for (i = 0; i < strlen (rest); i++)
+	  {
+	    if ((i == 0 || i == strlen (rest) - 1) && rest[i] == '"')
+	      continue;
+	    *p++ = rest[i];
+	  }
+	*p = 0;
+	g_free (rest);
+      }
+      break;
+    case STRING_SET_LARGE_PIXELS:
+      default_draw_marks = TRUE;
+      break;
+    case STRING_SET_XUNIT_TEXT:
+      if (prm_x_unit_text)
+	g_free (prm_x_unit_text);
+      prm_x_unit_text = string_strdup_rest (S_, 1);
+      break;
+    case STRING_SET_YUNIT_TEXT:
+      if (prm_y_unit_text)
+	g_free (prm_y_unit_text);
+      prm_y_unit_text = string_strdup_rest (S_, 1);
+      break;
+    }
+}
+
+/* Add points given as x,y pairs to a set of a live stream, or to the
+   current set if set_name is NULL */
+void
+loader_append_points (loader_t * loader, const char *set_name,
+		      const double *xy, guint num_points)
+{
+  point_t p;
+  guint idx;
+
+  if (set_name)
+    loader_select_set (loader, set_name);
+  else if (loader->is_new_set)
+    loader_start_set (loader);
+
+  p.op = OP_DRAW;
+  for (idx = 0; idx < num_points; idx++)
+    {
+      p.data.point.x = xy[2 * idx];
+      p.data.point.y = xy[2 * idx + 1];
+      dataset_append_point (loader->dataset, &p);
+    }
+}
+
+/* Remove all the sets that have been read, and start over as if
+   nothing had been read, for a file that has been rewritten */
+void
+loader_remove_sets (loader_t * loader)
+{
+  while (loader->set_ids->len > 0)
+    {
+      guint id = g_array_index (loader->set_ids, guint,
+				loader->set_ids->len - 1);
+
+      if (dataset_table_lookup (id))
+	loader_remove_set (loader, dataset_table_lookup (id));
+      else
+	g_array_set_size (loader->set_ids, loader->set_ids->len - 1);
+    }
+
+  if (loader->live_sets)
+    g_hash_table_remove_all (loader->live_sets);
+
+  /* The strings of the removed sets are freed with their arena, once
+     nothing else holds it */
+  gxgraph_arena_unref (loader->arena);
+  loader->arena = gxgraph_arena_new ();
+  loader->dataset = NULL;
+  loader->is_new_set = TRUE;
+  loader->linenum = 0;
+  loader->num_sets = 0;
+}
+
+/* The stream has ended */
+void
+loader_free (loader_t * loader)
+{
+  if (loader->is_tracing_dataset)
+    TRACE_END ("parse dataset");
+  loader_drop_empty_set (loader);
+
+  g_array_free (loader->set_ids, TRUE);
+  g_array_free (loader->set_idxs, TRUE);
+  if (loader->live_sets)
+    g_hash_table_destroy (loader->live_sets);
+  gxgraph_arena_unref (loader->arena);
+  g_free (loader->filename);
+  g_free (loader);
+}
+
+void
+read_data_sets (int argc, char *argv[])
+{
+  FILE *IN;
+  int argp = 0;
+  gboolean do_stdin = argc == 0;
+  gxgraph_arena_t *arena = gxgraph_arena_new ();
+  guint first_new_id;
+
+  if (!dataset_table)
+    dataset_table = g_ptr_array_new ();
+  first_new_id = dataset_table->len;
+
+  gxgraph_memstats_load_begin ();
+
+  while (argp < argc || do_stdin)
+    {
+      char *filename;
+      loader_t *loader;
+
+      if (do_stdin)
+	{
+	  IN = stdin;
+	  filename = "(stdin)";
+	}
+      else
+	{
+	  filename = argv[argp++];
+	  TRACE_BEGIN ("open", filename);
+	  IN = fopen (filename, "r");
+	  TRACE_END ("open");
+	}
+
+      if (!IN)
+	{
+	  fprintf (stderr, "Warning! Couldn't open %s!\n", filename);
+	  continue;
+	}
+
+      TRACE_BEGIN ("parse", filename);
+      loader = loader_new (filename, arena, LOADER_FILE);
+      while (!feof (IN))
+	{
+	  char S_[256];
+
+	  if (!fgets (S_, sizeof (S_), IN))
+	    break;
+	  loader_parse_line (loader, S_);
+	}
+      loader_free (loader);
+      TRACE_END ("parse");
+
+      fclose (IN);
+
+      if (do_stdin)
+          break;
+    }
+
+  finish_data_sets (first_new_id);
+
+  gxgraph_arena_unref (arena);
+  gxgraph_memstats_load_end ();
+}
+
+/* Prepare the datasets from first_id on, which have been read in full,
+   for drawing */
+void
+finish_data_sets (guint first_id)
+{
+  guint id;
+
+  /* Most data is sampled at a fixed x interval */
+  for (id = first_id; id < dataset_table->len; id++)
+    {
+      dataset_t *dataset_p = g_ptr_array_index (dataset_table, id);
+
+      if (!dataset_p)
+	continue;
+      dataset_finish (dataset_p);
+      dataset_make_uniform (dataset_p);
+    }
+}
+
+static void
+ring_box_add_slot (dataset_t * dataset, guint slot, pyramid_box_t * box)
+{
+  double x, y;
+
+  if (slot >= dataset->points->len)
+    return;
+  point_get_xy (&g_array_index (dataset->points, point_t, slot), &x, &y);
+
+  /* Compared this way, the NaN of the breaks are skipped */
+  if (x < box->x0)
+    box->x0 = x;
+  if (x > box->x1)
+    box->x1 = x;
+  if (y < box->y0)
+    box->y0 = y;
+  if (y > box->y1)
+    box->y1 = y;
+}
+
+/* The box of the slots of a ring dataset from first_slot to end_slot,
+   and of the slot before them */
+static void
+ring_block_box (gpointer user_data, guint first_slot, guint end_slot,
+		pyramid_box_t * box)
+{
+  dataset_t *dataset = user_data;
+  guint slot;
+
+  if (first_slot > 0)
+    ring_box_add_slot (dataset, first_slot - 1, box);
+  else if (dataset->points->len == dataset->ring_capacity)
+    ring_box_add_slot (dataset, dataset->ring_capacity - 1, box);
+  for (slot = first_slot; slot < end_slot; slot++)
+    ring_box_add_slot (dataset, slot, box);
+}
+
+static void
+dataset_update_pyramid (dataset_t * dataset)
+{
+  gxgraph_pyramid_update (dataset->pyramid, ring_block_box, dataset);
+}
+
+/* Find the bounding box of the points of a dataset, and if do_log,
+   of their positive coordinates on log axes. The boxes are kept, and
+   grow with the points that are appended. */
+static void
+dataset_update_bbox (dataset_t * ds_p, gboolean do_log)
+{
+  guint num_points = dataset_get_num_points (ds_p);
+  double min_x, max_x, min_y, max_y;
+  double min_pos_x, max_pos_x, min_pos_y, max_pos_y;
+  int p_idx;
+
+  if (ds_p->has_bbox && (ds_p->has_log_bbox || !do_log))
+    return;
+
+  min_x = min_y = HUGE;
+  max_x = max_y = -HUGE;
+  min_pos_x = min_pos_y = HUGE_VAL;
+  max_pos_x = max_pos_y = 0;
+
+  /* Spilled datasets know the bounding boxes of their chunks, and
+     only the chunks that reach zero must be paged in for log axes */
+  if (ds_p->spill)
+    {
+      guint chunk_idx;
+
+      for (chunk_idx = 0;
+	   chunk_idx < gxgraph_spill_get_num_chunks (ds_p->spill)
+	   && num_points > 0; chunk_idx++)
+	{
+	  const spill_chunk_t *chunk =
+	    gxgraph_spill_get_chunk (ds_p->spill, chunk_idx);
+
+	  min_x = MIN (min_x, chunk->x0);
+	  max_x = MAX (max_x, chunk->x1);
+	  min_y = MIN (min_y, chunk->y0);
+	  max_y = MAX (max_y, chunk->y1);
+	  if (!do_log)
+	    continue;
+
+	  if (chunk->x0 > 0 && chunk->y0 > 0)
+	    {
+	      min_pos_x = MIN (min_pos_x, chunk->x0);
+	      max_pos_x = MAX (max_pos_x, chunk->x1);
+	      min_pos_y = MIN (min_pos_y, chunk->y0);
+	      max_pos_y = MAX (max_pos_y, chunk->y1);
+	      continue;
+	    }
+	  for (p_idx = chunk_idx << SPILL_CHUNK_SHIFT;
+	       p_idx < num_points
+	       && p_idx < (chunk_idx + 1) << SPILL_CHUNK_SHIFT; p_idx++)
+	    {
+	      point_t p = dataset_get_point (ds_p, p_idx);
+
+	      if (p.data.point.x > 0)
+		{
+		  min_pos_x = MIN (min_pos_x, p.data.point.x);
+		  max_pos_x = MAX (max_pos_x, p.data.point.x);
+		}
+	      if (p.data.point.y > 0)
+		{
+		  min_pos_y = MIN (min_pos_y, p.data.point.y);
+		  max_pos_y = MAX (max_pos_y, p.data.point.y);
+		}
+	    }
+	}
+    }
+
+  /* So do ring datasets, and they keep the boxes up to date as the
+     slots are overwritten */
+  else if (ds_p->pyramid)
+    {
+      const pyramid_box_t *box;
+      guint block_idx;
+
+      dataset_update_pyramid (ds_p);
+      box = gxgraph_pyramid_get_root (ds_p->pyramid);
+      min_x = MIN (min_x, box->x0);
+      max_x = MAX (max_x, box->x1);
+      min_y = MIN (min_y, box->y0);
+      max_y = MAX (max_y, box->y1);
+
+      for (block_idx = 0;
+	   do_log && block_idx < gxgraph_pyramid_get_num_blocks (ds_p->pyramid);
+	   block_idx++)
+	{
+	  box = gxgraph_pyramid_get_block (ds_p->pyramid, block_idx);
+	  if (box->x0 > 0 && box->y0 > 0)
+	    {
+	      min_pos_x = MIN (min_pos_x, box->x0);
+	      max_pos_x = MAX (max_pos_x, box->x1);
+	      min_pos_y = MIN (min_pos_y, box->y0);
+	      max_pos_y = MAX (max_pos_y, box->y1);
+	      continue;
+	    }
+	  for (p_idx = block_idx << PYRAMID_BLOCK_SHIFT;
+	       p_idx < num_points
+	       && p_idx < (block_idx + 1) << PYRAMID_BLOCK_SHIFT; p_idx++)
+	    {
+	      double x, y;
+
+	      point_get_xy (&g_array_index (ds_p->points, point_t, p_idx),
+			    &x, &y);
+	      if (x > 0)
+		{
+		  min_pos_x = MIN (min_pos_x, x);
+		  max_pos_x = MAX (max_pos_x, x);
+		}
+	      if (y > 0)
+		{
+		  min_pos_y = MIN (min_pos_y, y);
+		  max_pos_y = MAX (max_pos_y, y);
+		}
+	    }
+	}
+    }
+
+  /* The x range of uniform datasets is known */
+  else if ((ds_p->storage == STORAGE_UNIFORM
+	    || ds_p->storage == STORAGE_UNIFORM_FLOAT) && num_points > 0
+	   && !do_log)
+    {
+      double x1 = ds_p->origin_x + (num_points - 1) * ds_p->step_x;
+
+      min_x = MIN (ds_p->origin_x, x1);
+      max_x = MAX (ds_p->origin_x, x1);
+      for (p_idx = 0; p_idx < num_points; p_idx++)
+	{
+	  double y = dataset_get_point (ds_p, p_idx).data.point.y;
+
+	  if (y < min_y)
+	    min_y = y;
+	  if (y > max_y)
+	    max_y = y;
+	}
+    }
+
+  else
+    {
+      for (p_idx = 0; p_idx < num_points; p_idx++)
+	{
+	  point_t p = dataset_get_point (ds_p, p_idx);
+	  double x, y;
+
+	  point_get_xy (&p, &x, &y);
+	  if (y < min_y)
+	    min_y = y;
+	  if (y > max_y)
+	    max_y = y;
+
+	  if (x < min_x)
+	    min_x = x;
+	  if (x > max_x)
+	    max_x = x;
+
+	  if (x > 0)
+	    {
+	      min_pos_x = MIN (min_pos_x, x);
+	      max_pos_x = MAX (max_pos_x, x);
+	    }
+	  if (y > 0)
+	    {
+	      min_pos_y = MIN (min_pos_y, y);
+	      max_pos_y = MAX (max_pos_y, y);
+	    }
+	}
+    }
+
+  ds_p->bbox_x0 = min_x;
+  ds_p->bbox_x1 = max_x;
+  ds_p->bbox_y0 = min_y;
+  ds_p->bbox_y1 = max_y;
+  ds_p->has_bbox = TRUE;
+  if (do_log)
+    {
+      /* An empty range if there are no positive values */
+      ds_p->log_x0 = min_pos_x <= max_pos_x ? log10 (min_pos_x) : HUGE_VAL;
+      ds_p->log_x1 = min_pos_x <= max_pos_x ? log10 (max_pos_x) : -HUGE_VAL;
+      ds_p->log_y0 = min_pos_y <= max_pos_y ? log10 (min_pos_y) : HUGE_VAL;
+      ds_p->log_y1 = min_pos_y <= max_pos_y ? log10 (max_pos_y) : -HUGE_VAL;
+      ds_p->has_log_bbox = TRUE;
+    }
+}
+
+/* The world that shows all the datasets of the window */
+static void
+fit_world (window_t * window, world_t * world)
+{
+  double min_x, max_x, min_y, max_y;
+  double world_pad_x, world_pad_y;
+  dataset_t *ds_p;
+  guint ds_idx;
+
+  min_x = min_y = HUGE;
+  max_x = max_y = -HUGE;
+  if (window->do_logx)
+    {
+      min_x = HUGE_VAL;
+      max_x = -HUGE_VAL;
+    }
+  if (window->do_logy)
+    {
+      min_y = HUGE_VAL;
+      max_y = -HUGE_VAL;
+    }
+
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    {
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
+      dataset_update_bbox (ds_p, window->do_logx || window->do_logy);
+
+      min_x = MIN (min_x, window->do_logx ? ds_p->log_x0 : ds_p->bbox_x0);
+      max_x = MAX (max_x, window->do_logx ? ds_p->log_x1 : ds_p->bbox_x1);
+      min_y = MIN (min_y, window->do_logy ? ds_p->log_y0 : ds_p->bbox_y0);
+      max_y = MAX (max_y, window->do_logy ? ds_p->log_y1 : ds_p->bbox_y1);
+    }
+
+  /* Log axes without any positive values */
+  if (min_x > max_x)
+    {
+      min_x = 0;
+      max_x = 1;
+    }
+  if (min_y > max_y)
+    {
+      min_y = 0;
+      max_y = 1;
+    }
+
+  /* Check if external paramaters are valid, then use these.
+     If both x and y are overridden then it is a waste of
+     time to search for the min and max above, but I am ignoring
+     that for the moment.
+   */
+  if (prm_x_hi_limit > prm_x_low_limit
+      && (!window->do_logx || prm_x_low_limit > 0))
+    {
+      min_x = window->do_logx ? log10 (prm_x_low_limit) : prm_x_low_limit;
+      max_x = window->do_logx ? log10 (prm_x_hi_limit) : prm_x_hi_limit;
+    }
+  if (prm_y_hi_limit > prm_y_low_limit
+      && (!window->do_logy || prm_y_low_limit > 0))
+    {
+      min_y = window->do_logy ? log10 (prm_y_low_limit) : prm_y_low_limit;
+      max_y = window->do_logy ? log10 (prm_y_hi_limit) : prm_y_hi_limit;
+    }
+      
+  /* Add 10% padding */
+  world_pad_x = (max_x - min_x) * 0.05;
+  world_pad_y = (max_y - min_y) * 0.05;
+  world->x0 = min_x - world_pad_x;
+  world->x1 = max_x + world_pad_x;
+  world->y0 = min_y - world_pad_y;
+  world->y1 = max_y + world_pad_y;
+
+  /* A strip that ends with the newest points. It slides along by
+     whole pixels, so that what has been drawn can be scrolled. */
+  if (prm_strip_width > 0 && !window->do_logx
+      && !(prm_x_hi_limit > prm_x_low_limit))
+    {
+      double x1 = max_x + prm_strip_width * 0.05;
+
+      if (window->opp_x > window->org_x)
+	{
+	  double pixel = prm_strip_width / (window->opp_x - window->org_x);
+
+	  x1 = window->world.x1
+	    + ceil ((x1 - window->world.x1) / pixel) * pixel;
+	}
+      world->x0 = x1 - prm_strip_width;
+      world->x1 = x1;
+    }
+}
+
+/* Show the datasets of the table in the window. The window keeps its
+   own list of them. */
+void
+put_datasets_in_window (GPtrArray * datasets,
+			window_t * window, world_t * world)
+{
+  guint ds_idx;
+
+  /* Only the world is recomputed for the datasets already shown */
+  if (datasets != window->datasets)
+    {
+      g_ptr_array_set_size (window->datasets, 0);
+      for (ds_idx = 0; datasets && ds_idx < datasets->len; ds_idx++)
+	if (g_ptr_array_index (datasets, ds_idx))
+	  g_ptr_array_add (window->datasets,
+			   g_ptr_array_index (datasets, ds_idx));
+
+      /* A window of the whole table shows the sets that are read
+         later as well */
+      window->do_add_new_sets = datasets == dataset_table;
+      window->num_ids_seen = datasets ? datasets->len : 0;
+    }
+
+  window->do_fit = world == NULL;
+  if (world)
+    {
+      window->world.x0 = world->x0;
+      window->world.x1 = world->x1;
+      window->world.y0 = world->y0;
+      window->world.y1 = world->y1;
+    }
+  else
+    fit_world (window, &window->world);
+
+  window->world.col_0 = 20;
+  window->world.scale_x =
+    1.0 * (window->width - 40) / (window->world.x1 - window->world.x0);
+  window->world.scale_y =
+    1.0 * -(window->height - 40) / (window->world.y1 - window->world.y0);
+
+  window->world.col_0 = 20 - window->world.x0 * window->world.scale_x;
+  if (window->gtk_painter)
+    gxgraph_draw_window (window, NULL);
+}
+
+#ifndef GXGRAPH_NO_MAIN
+/* Read the data sets and render them to a file */
+static int
+export_data_sets (const char *output_filename, int argc, char *argv[])
+{
+  window_t *window;
+  int ret;
+
+  read_data_sets (argc, argv);
+
+  window = new_headless_window ();
+  put_datasets_in_window (dataset_table, window, NULL);
+
+  ret = gxgraph_export (window, output_filename) == 0 ? 0 : 1;
+  if (prm_do_memstats)
+    gxgraph_memstats_print (stdout, dataset_table, window);
+
+  return ret;
+}
+
+/* Draw the data sets with the null painter and print what it was
+   asked to draw */
+static int
+count_data_sets (int argc, char *argv[])
+{
+  GTimer *timer;
+  window_t *window;
+  painter_t *painter;
+
+  read_data_sets (argc, argv);
+
+  window = new_headless_window ();
+  put_datasets_in_window (dataset_table, window, NULL);
+  painter = null_painter_new (window);
+  if (compute_transform (window, painter) != 0)
+    return 1;
+
+  timer = g_timer_new ();
+  gxgraph_draw_window (window, painter);
+  g_timer_stop (timer);
+
+  /* The counts alone don't change between runs */
+  null_painter_print_summary (painter, stdout,
+			      strcmp (prm_painter_name, "counts") == 0
+			      ? -1 : g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+  null_painter_delete (painter);
+  if (prm_do_memstats)
+    gxgraph_memstats_print (stdout, dataset_table, window);
+
+  return 0;
+}
+
+/* Run a single line of a batch file */
+static int
+run_job (gchar ** job)
+{
+  GPtrArray *inputs = g_ptr_array_new ();
+  char *output_filename = NULL;
+  int ret;
+  int idx;
+
+  for (idx = 0; job[idx]; idx++)
+    {
+      if (strlen (job[idx]) == 0)
+	continue;
+      if (strcmp (job[idx], "-size") == 0 && job[idx + 1])
+	{
+	  sscanf (job[++idx], "%dx%d",
+		  &prm_requested_width, &prm_requested_height);
+	  continue;
+	}
+      if (!output_filename)
+	output_filename = job[idx];
+      else
+	g_ptr_array_add (inputs, job[idx]);
+    }
+
+  if (!output_filename || inputs->len == 0)
+    {
+      fprintf (stderr, "Job needs an output and at least one input!\n");
+      g_ptr_array_free (inputs, TRUE);
+      return 1;
+    }
+
+  ret = export_data_sets (output_filename, inputs->len,
+			  (char **) inputs->pdata);
+  g_ptr_array_free (inputs, TRUE);
+
+  return ret;
+}
+
+/* Run all the jobs of a batch file, using up to num_jobs processes.
+   Every job is run in its own process so that the global parameters
+   and datasets of one job never leak into another. */
+static int
+run_batch (const char *batch_filename, int num_jobs)
+{
+  FILE *BATCH = fopen (batch_filename, "r");
+  char S_[MAXBUFSIZE];
+  int num_running = 0;
+  int num_failed = 0;
+
+  if (!BATCH)
+    die ("Couldn't open %s!\n", batch_filename);
+
+  while (fgets (S_, sizeof (S_), BATCH))
+    {
+      gchar **job;
+
+      g_strstrip (S_);
+      if (S_[0] == 0 || S_[0] == '#')
+	continue;
+
+      job = g_strsplit_set (S_, " \t", -1);
+#ifdef G_OS_WIN32
+      /* No fork. Run the jobs one by one in this process. */
+      if (dataset_table)
+	g_ptr_array_set_size (dataset_table, 0);
+      num_datasets = 0;
+      if (run_job (job) != 0)
+	num_failed++;
+#else
+      {
+	pid_t pid;
+	int status;
+
+	if (num_running >= num_jobs)
+	  {
+	    if (wait (&status) > 0)
+	      {
+		num_running--;
+		if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+		  num_failed++;
+	      }
+	  }
+
+	fflush (stdout);
+	fflush (stderr);
+	pid = fork ();
+	if (pid == 0)
+	  {
+	    /* Only the parent writes the trace */
+	    gxgraph_trace_is_enabled = FALSE;
+	    _exit (run_job (job));
+	  }
+	if (pid < 0)
+	  {
+	    fprintf (stderr, "Failed starting job for %s!\n", job[0]);
+	    num_failed++;
+	  }
+	else
+	  num_running++;
+      }
+#endif
+      g_strfreev (job);
+    }
+  fclose (BATCH);
+
+#ifndef G_OS_WIN32
+  while (num_running > 0)
+    {
+      int status;
+
+      if (wait (&status) <= 0)
+	break;
+      num_running--;
+      if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+	num_failed++;
+    }
+#endif
+
+  if (num_failed)
+    fprintf (stderr, "%d job(s) failed!\n", num_failed);
+
+  return num_failed ? 1 : 0;
+}
+#endif /* GXGRAPH_NO_MAIN */
+
+void
+die (const char *fmt, ...)
+{
+  va_list ap;
+  va_start (ap, fmt);
+
+  vfprintf (stderr, fmt, ap);
+  exit (-1);
+}
+
+void
+gxgraph_add_window_with_world (window_t * previous_window, world_t * world)
+{
+  window_t *window = new_window (previous_window);
+
+  put_datasets_in_window (previous_window->datasets, window, world);
+  window->do_add_new_sets = previous_window->do_add_new_sets;
+  window->num_ids_seen = previous_window->num_ids_seen;
+}
+
+/* Open a window after the last one that shows the datasets. A width
+   or height of 0 is the default one. */
+void
+gxgraph_add_window (GPtrArray * datasets, int width, int height)
+{
+  window_t *last_window = first_window;
+  window_t *window;
+  gint default_width = prm_requested_width;
+  gint default_height = prm_requested_height;
+
+  while (last_window && last_window->next_window)
+    last_window = last_window->next_window;
+
+  if (width > 0 && height > 0)
+    {
+      prm_requested_width = width;
+      prm_requested_height = height;
+    }
+  window = new_window (last_window);
+  prm_requested_width = default_width;
+  prm_requested_height = default_height;
+
+  if (!first_window)
+    first_window = window;
+  put_datasets_in_window (datasets, window, NULL);
+}
+
+/* Whether any of the windows shows the dataset */
+gboolean
+gxgraph_is_dataset_shown (dataset_t * dataset)
+{
+  window_t *window;
+  guint ds_idx;
+
+  for (window = first_window; window; window = window->next_window)
+    for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+      if (g_ptr_array_index (window->datasets, ds_idx) == dataset)
+	return TRUE;
+
+  return FALSE;
+}
+
+/* Add the sets that were added to the table since the window last
+   looked at it, if the window shows the whole table */
+static void
+window_add_new_datasets (window_t * window)
+{
+  guint id;
+
+  if (!window->do_add_new_sets || !dataset_table)
+    return;
+
+  for (id = window->num_ids_seen; id < dataset_table->len; id++)
+    if (g_ptr_array_index (dataset_table, id))
+      g_ptr_array_add (window->datasets,
+		       g_ptr_array_index (dataset_table, id));
+  window->num_ids_seen = dataset_table->len;
+}
+
+/* Show the datasets that were added or have grown since the windows
+   were drawn. Windows that are fitted to the data are fitted again,
+   while zoomed windows keep their world. Points appended without
+   changing the world are drawn on top of the rest, and a strip that
+   slides along with them is scrolled. Windows that show only some of
+   the sets, like those of the server, keep to them. */
+void
+gxgraph_update_windows (void)
+{
+  window_t *window;
+
+  for (window = first_window; window; window = window->next_window)
+    {
+      window_add_new_datasets (window);
+      if (!gtk_painter_scroll (window)
+	  && !gtk_painter_draw_appended (window))
+	gtk_painter_redraw (window, window->datasets,
+			    window->do_fit ? NULL : &window->world);
+    }
+}
+
+static guint update_id = 0;
+static GTimer *update_timer = NULL;
+
+static gboolean
+cb_update_windows (gpointer user_data)
+{
+  update_id = 0;
+  gxgraph_update_windows ();
+  g_timer_start (update_timer);
+
+  return FALSE;
+}
+
+/* Update the windows with data that has arrived. Data that arrives
+   within 1/prm_max_redraw_rate seconds of a redraw is drawn at once
+   with the next one. */
+void
+gxgraph_schedule_update (void)
+{
+  double wait = 0;
+
+  if (update_id)
+    return;
+
+  if (!update_timer)
+    update_timer = g_timer_new ();
+  else if (prm_max_redraw_rate > 0)
+    wait = 1.0 / prm_max_redraw_rate - g_timer_elapsed (update_timer, NULL);
+  update_id = g_timeout_add (wait > 0 ? (guint) (wait * 1000) : 0,
+			     cb_update_windows, NULL);
+}
+
+window_t *
+new_window (window_t * previous_window)
+{
+  window_t *window;
+
+  TRACE_BEGIN ("new window", NULL);
   window = (window_t *) g_malloc (sizeof (window_t));
-  window->first_dataset = NULL;
+  window->datasets = g_ptr_array_new ();
+  window->num_drawn = g_array_new (FALSE, FALSE, sizeof (guint));
+  window->last_x_drawn = g_array_new (FALSE, FALSE, sizeof (double));
+  window->org_x = window->opp_x = 0;
   window->width = prm_requested_width;
   window->height = prm_requested_height;
+  window->do_logx = previous_window ? previous_window->do_logx : prm_do_logx;
+  window->do_logy = previous_window ? previous_window->do_logy : prm_do_logy;
   window->next_window = 0;
   if (previous_window)
     previous_window->next_window = window;
   window->previous_window = previous_window;
   window->gtk_painter = gtk_painter_new (window);
+  TRACE_END ("new window");
+
+  return window;
+}
+
+/* A window that is only used for rendering to files */
+window_t *
+new_headless_window (void)
+{
+  window_t *window = g_new0 (window_t, 1);
+
+  window->datasets = g_ptr_array_new ();
+  window->width = prm_requested_width;
+  window->height = prm_requested_height;
+  window->do_logx = prm_do_logx;
+  window->do_logy = prm_do_logy;
 
   return window;
 }
 
+/* Make a copy of the window and its dataset list that can be drawn
+   from another thread while the original window keeps changing. The
+   points and strings are shared as datasets are not modified after
+   loading, except for the points of live datasets which are copied. */
+window_t *
+gxgraph_window_snapshot (window_t * window)
+{
+  window_t *snapshot = g_new (window_t, 1);
+  guint ds_idx;
+
+  *snapshot = *window;
+  snapshot->next_window = NULL;
+  snapshot->previous_window = NULL;
+  snapshot->gtk_painter = NULL;
+  snapshot->num_drawn = NULL;
+  snapshot->last_x_drawn = NULL;
+  snapshot->datasets = g_ptr_array_sized_new (window->datasets->len);
+
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    {
+      dataset_t *copy = g_new (dataset_t, 1);
+
+      *copy = *(dataset_t *) g_ptr_array_index (window->datasets, ds_idx);
+      gxgraph_arena_ref (copy->arena);
+
+      /* The boxes of a ring are updated as it is drawn, and the copy
+         is drawn without them */
+      copy->pyramid = NULL;
+      if (copy->is_live)
+	{
+	  GArray *points = copy->points;
+	  GPtrArray *text_marks = copy->text_marks;
+	  guint idx;
+
+	  copy->points =
+	    g_array_sized_new (FALSE, FALSE,
+			       g_array_get_element_size (points),
+			       points->len);
+	  g_array_append_vals (copy->points, points->data, points->len);
+	  copy->text_marks = NULL;
+	  if (text_marks)
+	    {
+	      copy->text_marks = g_ptr_array_sized_new (text_marks->len);
+	      for (idx = 0; idx < text_marks->len; idx++)
+		g_ptr_array_add (copy->text_marks,
+				 g_ptr_array_index (text_marks, idx));
+	    }
+	}
+      else
+	{
+	  if (copy->points)
+	    g_array_ref (copy->points);
+	  if (copy->text_marks)
+	    g_ptr_array_ref (copy->text_marks);
+	}
+      if (copy->spill)
+	gxgraph_spill_ref (copy->spill);
+      g_ptr_array_add (snapshot->datasets, copy);
+    }
+
+  return snapshot;
+}
+
+void
+gxgraph_window_snapshot_free (window_t * snapshot)
+{
+  guint ds_idx;
+
+  for (ds_idx = 0; ds_idx < snapshot->datasets->len; ds_idx++)
+    {
+      dataset_t *ds_p = g_ptr_array_index (snapshot->datasets, ds_idx);
+
+      if (ds_p->points)
+	g_array_unref (ds_p->points);
+      if (ds_p->spill)
+	gxgraph_spill_unref (ds_p->spill);
+      if (ds_p->text_marks)
+	g_ptr_array_unref (ds_p->text_marks);
+      gxgraph_arena_unref (ds_p->arena);
+      g_free (ds_p);
+    }
+  g_ptr_array_free (snapshot->datasets, TRUE);
+  g_free (snapshot);
+}
+
+/* Seconds since the previous lap */
+static double
+stats_lap (GTimer * timer, double *lap)
+{
+  double now = g_timer_elapsed (timer, NULL);
+  double seconds = now - *lap;
+
+  *lap = now;
+  return seconds;
+}
+
 void
 gxgraph_draw_window (window_t * window, painter_t * painter)
 {
+  render_stats_t *stats;
+  GTimer *timer = NULL;
+  double lap = 0;
+
   /* Use the gtk painter if no other painter has been provided */
   if (painter == NULL)
     {
@@ -717,18 +2536,114 @@ gxgraph_draw_window (window_t * window, painter_t * painter)
       /* This is somewhat of a hack. The transform should only
        * be calculated for gtk windows...
       */
+      TRACE_BEGIN ("compute transform", NULL);
       compute_transform (window, painter);
+      TRACE_END ("compute transform");
     }
 
-  if (window->first_dataset == NULL)
-    return;
+  stats = painter->stats;
+  if (stats)
+    {
+      if (stats->datasets)
+	g_array_set_size (stats->datasets, 0);
+      else
+	stats->datasets = g_array_new (FALSE, FALSE, sizeof (dataset_stats_t));
+      stats->seconds = stats->text_seconds = 0;
+      stats->grid_seconds = stats->data_seconds = 0;
+      stats->lod_dpi = painter->lod_dpi;
+      timer = g_timer_new ();
+    }
 
+  if (window->datasets->len == 0)
+    {
+      if (timer)
+	g_timer_destroy (timer);
+      return;
+    }
+
+  TRACE_BEGIN ("draw title", NULL);
   gxgraph_draw_title (window, painter);
+  TRACE_END ("draw title");
+
+  TRACE_BEGIN ("draw legend", NULL);
+  gxgraph_draw_legend (window, painter);
+  TRACE_END ("draw legend");
+  if (stats)
+    stats->text_seconds = stats_lap (timer, &lap);
+
+  TRACE_BEGIN ("draw grid and axis", NULL);
+  gxgraph_draw_grid_and_axis (window, painter);
+  TRACE_END ("draw grid and axis");
+  if (stats)
+    stats->grid_seconds = stats_lap (timer, &lap);
+
+  TRACE_BEGIN ("draw data", NULL);
+  gxgraph_draw_data (window, painter);
+  TRACE_END ("draw data");
+  if (stats)
+    {
+      stats->data_seconds = stats_lap (timer, &lap);
+      stats->seconds = lap;
+      g_timer_destroy (timer);
+    }
+
+}
+
+/* The size in pixels of a text as the painter draws it. Painters that
+   can't measure their texts give the size of its characters. */
+static void
+get_text_size (painter_t * painter, const char *text, int style,
+	       int *width, int *height)
+{
+  if (painter->get_text_size)
+    {
+      painter->get_text_size (painter, text, style, width, height);
+      return;
+    }
+
+  *width = strlen (text)
+    * (style == T_TITLE ? painter->title_width : painter->axis_width);
+  *height = style == T_TITLE ? painter->title_height : painter->axis_height;
+}
 
-  gxgraph_draw_legend (window, painter);
+/* Width of the widest label of the y axis ticks, for the world of the
+   window between org_y and opp_y */
+static int
+get_y_labels_width (window_t * window, painter_t * painter)
+{
+  world_t *world = &window->world;
+  double scale_y, world_org_y, world_opp_y;
+  GArray *y_ticks;
+  char value[10];
+  int expY, width, height, max_width = 0;
+  guint tick_idx;
+
+  /* Room for seven characters, as there is nothing to measure with */
+  if (!painter->get_text_size)
+    return 7 * painter->axis_width;
+
+  /* The ticks of gxgraph_draw_grid_and_axis () */
+  scale_y = (world->y1 - world->y0) / (window->opp_y - window->org_y);
+  world_org_y = (world->y0 + world->y1) / 2.0
+    - (window->opp_y - window->org_y) / 2.0 * scale_y;
+  world_opp_y = (world->y0 + world->y1) / 2.0
+    + (window->opp_y - window->org_y) / 2.0 * scale_y;
+  expY = axis_exponent (world->y0, world->y1, window->do_logy);
+  y_ticks = grid_ticks_new (world_org_y, world_opp_y,
+			    (painter->axis_pad + painter->axis_height)
+			    * scale_y, window->do_logy);
+
+  for (tick_idx = 0; tick_idx < y_ticks->len; tick_idx++)
+    {
+      write_value (value, g_array_index (y_ticks, double, tick_idx),
+		   expY, 1, window->do_logy);
+      get_text_size (painter, value, T_AXIS, &width, &height);
+      if (width > max_width)
+	max_width = width;
+    }
+  g_array_free (y_ticks, TRUE);
 
-  gxgraph_draw_grid_and_axis (window, painter);
-  gxgraph_draw_data (window, painter);
+  return max_width;
 }
 
 /*
@@ -744,48 +2659,63 @@ int
 compute_transform (window_t * window, painter_t * painter)
 {
   double bbCenX, bbCenY, bbHalfWidth, bbHalfHeight;
-  int maxName, leftWidth;
+  int leftWidth, width, height, expX;
+  char power[10], value[10], final[256];
   dataset_t *ds_p;
+  guint ds_idx;
 
   /*
-   * First,  we figure out the origin in the X window.  Above
+   * First,  we figure out the vertical extent of the plot.  Above
    * the space we have the title and the Y axis unit label.
-   * To the left of the space we have the Y axis grid labels.
+   * Below it we have the X axis grid labels.
    */
-
-  window->org_x = painter->bdr_pad + (7 * painter->axis_width)
-    + painter->bdr_pad;
   window->org_y = painter->bdr_pad + painter->title_height
     + painter->bdr_pad + painter->axis_height
     + painter->axis_height / 2 + painter->bdr_pad;
 
+  expX = axis_exponent (window->world.x0, window->world.x1, window->do_logx);
+  write_value (value, window->world.x0, expX, 0, window->do_logx);
+  get_text_size (painter, value, T_AXIS, &width, &height);
+  window->opp_y = painter->area_h - painter->bdr_pad
+    - height - painter->bdr_pad;
+
+  /*
+   * To the left of the space we have the Y axis grid labels, whose
+   * ticks depend on the vertical extent.
+   */
+  if (window->org_y < window->opp_y)
+    window->org_x = painter->bdr_pad + get_y_labels_width (window, painter)
+      + painter->bdr_pad;
+  else
+    window->org_x = painter->bdr_pad;
+
   /*
-   * Now we find the lower right corner.  Below the space we
-   * have the X axis grid labels.  To the right of the space we
-   * have the X axis unit label and the legend.  We assume the 
-   * worst case size for the unit label.
+   * To the right of the space we have the X axis unit label and
+   * the legend.
    */
-  maxName = 0;
-  for (ds_p = window->first_dataset; ds_p; ds_p = ds_p->next_dataset)
+  if (expX != 0)
     {
-      int tempSize;
+      sprintf (power, "%d", expX);
+      g_snprintf (final, sizeof (final), "%s x 10", prm_x_unit_text);
+      get_text_size (painter, final, T_AXIS, &leftWidth, &height);
+      get_text_size (painter, power, T_AXIS, &width, &height);
+      leftWidth += width;
+    }
+  else
+    get_text_size (painter, prm_x_unit_text, T_AXIS, &leftWidth, &height);
 
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    {
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
       if (!ds_p->set_name)
 	continue;
 
-      tempSize = strlen (ds_p->set_name);
-      if (tempSize > maxName)
-	maxName = tempSize;
+      get_text_size (painter, ds_p->set_name, T_AXIS, &width, &height);
+      if (width + painter->bdr_pad > leftWidth)
+	leftWidth = width + painter->bdr_pad;
     }
 
-  /* Worst case size of the X axis label: */
-  leftWidth = (strlen (prm_x_unit_text)) * painter->axis_width;
-  if ((maxName * painter->axis_width) + painter->bdr_pad > leftWidth)
-    leftWidth = maxName * painter->axis_width + painter->bdr_pad;
-
   window->opp_x = painter->area_w - painter->bdr_pad - leftWidth;
-  window->opp_y = painter->area_h - painter->bdr_pad
-    - painter->axis_height - painter->bdr_pad;
 
   if ((window->org_x >= window->opp_x) || (window->org_y >= window->opp_y))
     {
@@ -847,6 +2777,7 @@ void
 gxgraph_draw_legend (window_t * window, painter_t * painter)
 {
   dataset_t *ds_p;
+  guint ds_idx;
   int spot, lineLen;
   double leg_line_x1, leg_line_x2;
   double scale_x = 1.0;
@@ -857,8 +2788,9 @@ gxgraph_draw_legend (window_t * window, painter_t * painter)
   lineLen = 0;
 
   /* First pass draws the text */
-  for (ds_p = window->first_dataset; ds_p; ds_p = ds_p->next_dataset)
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
     {
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
       if (spot + painter->axis_height + 2 < window->opp_y)
 	{
 	  /* Meets the criteria */
@@ -872,6 +2804,9 @@ gxgraph_draw_legend (window_t * window, painter_t * painter)
 
 	  spot += 2 + painter->axis_height + painter->bdr_pad;
 	}
+      else
+	/* And none of the following ones fit either */
+	break;
     }
   lineLen = lineLen * painter->axis_width;
 
@@ -881,8 +2816,9 @@ gxgraph_draw_legend (window_t * window, painter_t * painter)
   spot = window->org_y;
 
   /* second pass draws the lines */
-  for (ds_p = window->first_dataset; ds_p; ds_p = ds_p->next_dataset)
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
     {
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
       if (spot + painter->axis_height + 2 < window->opp_y)
 	{
 	  double leg_line_y = spot - painter->legend_pad;
@@ -918,18 +2854,36 @@ gxgraph_draw_legend (window_t * window, painter_t * painter)
 
 	  spot += 2 + painter->axis_height + painter->bdr_pad;
 	}
+      else
+	break;
     }
 }
 
+/*
+ * Grid display powers are computed by taking the log of
+ * the largest numbers and rounding down to the nearest
+ * multiple of 3.
+ */
+static int
+axis_exponent (double v0, double v1, gboolean do_log)
+{
+  if (do_log)
+    return 0;
+
+  return ((int) floor (nlog10 (MAX (fabs (v0), fabs (v1))) / 3.0)) * 3;
+}
+
 void
 gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 {
   int expX, expY;		/* Engineering powers */
   int startX;
   int Yspot, Xspot;
-  double Xincr, Yincr, Xstart, Ystart, Yindex, Xindex, larger;
+  double Xincr, Yincr, Yindex, Xindex;
   char power[10], value[10], final[256];
   world_t *world = &window->world;
+  GArray *x_ticks, *y_ticks;
+  guint tick_idx;
 
   painter->group_start (painter, "grid");
 
@@ -937,43 +2891,8 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
     painter = window->gtk_painter;
 
   painter->set_attributes_style (painter, L_AXIS);
-  /*
-   * Grid display powers are computed by taking the log of
-   * the largest numbers and rounding down to the nearest
-   * multiple of 3.
-   */
-  if (prm_do_logx)
-    {
-      expX = 0;
-    }
-  else
-    {
-      if (fabs (window->world.x0) > fabs (window->world.x1))
-	{
-	  larger = fabs (window->world.x0);
-	}
-      else
-	{
-	  larger = fabs (window->world.x1);
-	}
-      expX = ((int) floor (nlog10 (larger) / 3.0)) * 3;
-    }
-  if (prm_do_logy)
-    {
-      expY = 0;
-    }
-  else
-    {
-      if (fabs (window->world.y0) > fabs (window->world.y1))
-	{
-	  larger = fabs (window->world.y0);
-	}
-      else
-	{
-	  larger = fabs (window->world.y1);
-	}
-      expY = ((int) floor (nlog10 (larger) / 3.0)) * 3;
-    }
+  expX = axis_exponent (window->world.x0, window->world.x1, window->do_logx);
+  expY = axis_exponent (window->world.y0, window->world.y1, window->do_logy);
 
   /*
    * With the powers computed,  we can draw the axis labels.
@@ -1018,29 +2937,34 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 			  T_AXIS);
     }
 
+  /* The ticks are shared by the labels and the lines */
+  Yincr = (painter->axis_pad + painter->axis_height) * world->scale_y;
+  y_ticks = grid_ticks_new (window->world_org_y, window->world_opp_y, Yincr,
+			    window->do_logy);
+  Xincr = (painter->axis_pad + (painter->axis_width * 7)) * world->scale_x;
+  x_ticks = grid_ticks_new (window->world_org_x, window->world_opp_x, Xincr,
+			    window->do_logx);
+
   /* 
    * First,  the grid line labels
    */
-  Yincr = (painter->axis_pad + painter->axis_height) * world->scale_y;
-  Ystart = init_grid (window->world_org_y, Yincr, prm_do_logy);
-  for (Yindex = Ystart; Yindex < window->world_opp_y; Yindex = step_grid ())
+  for (tick_idx = 0; tick_idx < y_ticks->len; tick_idx++)
     {
-
+      Yindex = g_array_index (y_ticks, double, tick_idx);
       Yspot = SCREENY (window, Yindex);
       /* Write the axis label */
-      write_value (value, Yindex, expY, 1, prm_do_logy);
+      write_value (value, Yindex, expY, 1, window->do_logy);
       painter->draw_text (painter,
-			  painter->bdr_pad + 7 * painter->axis_width,
+			  window->org_x - painter->bdr_pad,
 			  Yspot, value, T_RIGHT, T_AXIS);
     }
 
-  Xincr = (painter->axis_pad + (painter->axis_width * 7)) * world->scale_x;
-  Xstart = init_grid (window->world_org_x, Xincr, prm_do_logx);
-  for (Xindex = Xstart; Xindex < window->world_opp_x; Xindex = step_grid ())
+  for (tick_idx = 0; tick_idx < x_ticks->len; tick_idx++)
     {
+      Xindex = g_array_index (x_ticks, double, tick_idx);
       Xspot = SCREENX (window, Xindex);
       /* Write the axis label */
-      write_value (value, Xindex, expX, 0, prm_do_logx);
+      write_value (value, Xindex, expX, 0, window->do_logx);
       painter->draw_text (painter,
 			  Xspot,
 			  painter->area_h - painter->bdr_pad,
@@ -1050,12 +2974,11 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
   /*
    * Now,  the grid lines or tick marks
    */
-  Yincr = (painter->axis_pad + painter->axis_height) * world->scale_y;
-  Ystart = init_grid (window->world_org_y, Yincr, prm_do_logy);
-  for (Yindex = Ystart; Yindex < window->world_opp_y; Yindex = step_grid ())
+  for (tick_idx = 0; tick_idx < y_ticks->len; tick_idx++)
     {
       double sx1, sx2, sx3, sx4, sy;
 
+      Yindex = g_array_index (y_ticks, double, tick_idx);
       Yspot = SCREENY (window, Yindex);
       sy = Yspot;
 
@@ -1074,7 +2997,7 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 	}
 
       if ((ABS (Yindex) < ZERO_THRESH * (world->y1 - world->y0))
-	  && !prm_do_logy)
+	  && !window->do_logy)
 	{
 	  painter->set_attributes_style (painter, L_ZERO);
 	}
@@ -1091,12 +3014,11 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 
     }
 
-  Xincr = (painter->axis_pad + (painter->axis_width * 7)) * world->scale_x;
-  Xstart = init_grid (window->world_org_x, Xincr, prm_do_logx);
-  for (Xindex = Xstart; Xindex < window->world_opp_x; Xindex = step_grid ())
+  for (tick_idx = 0; tick_idx < x_ticks->len; tick_idx++)
     {
       double sx, sy1, sy2, sy3, sy4;
 
+      Xindex = g_array_index (x_ticks, double, tick_idx);
       Xspot = SCREENX (window, Xindex);
       sx = Xspot;
       /* Draw the grid line or tick marks */
@@ -1113,7 +3035,7 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 	  sy2 = window->opp_y;
 	}
       if ((ABS (Xindex) < ZERO_THRESH * (world->x1 - world->x0))
-	  && !prm_do_logx)
+	  && !window->do_logx)
 	{
 	  painter->set_attributes_style (painter, L_ZERO);
 	}
@@ -1146,6 +3068,9 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
 			  window->org_x, window->org_y);
     }
 
+  g_array_free (x_ticks, TRUE);
+  g_array_free (y_ticks, TRUE);
+
   painter->group_end (painter, "grid");
 }
 
@@ -1163,31 +3088,364 @@ gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter)
   else if ((yval) > window->world_opp_y) rtn |= TOP_CODE
 
 
-void
-gxgraph_draw_data (window_t * window, painter_t * painter)
+/*======================================================================
+//  Level of detail decimation. Lines are reduced to their min/max
+//  extent within each device column and marks to one per device
+//  cell. At the chosen resolution the result looks the same.
+//----------------------------------------------------------------------
+*/
+typedef struct
+{
+  GArray *segs;
+  double cell;
+  glong num_added;
+
+  /* The run of connected segments within the current column */
+  gboolean in_run;
+  int num_in_run;
+  double col;
+  seg_t first;
+  double last_x, last_y;
+  double min_y, max_y;
+} lod_lines_t;
+
+typedef struct
+{
+  GArray *marks;
+  double cell;
+  glong num_added;
+  int ncols, nrows;
+  guint8 *occupied;
+} lod_marks_t;
+
+static void
+lod_lines_init (lod_lines_t * lod, GArray * segs, double cell)
+{
+  memset (lod, 0, sizeof (*lod));
+  lod->segs = segs;
+  lod->cell = cell;
+}
+
+static void
+lod_lines_flush (lod_lines_t * lod)
+{
+  seg_t seg;
+  double x;
+
+  if (!lod->in_run)
+    return;
+  lod->in_run = FALSE;
+
+  if (lod->num_in_run == 1)
+    {
+      g_array_append_val (lod->segs, lod->first);
+      return;
+    }
+
+  /* Entry point to the extreme, the vertical extent, and on to the
+     exit point. */
+  x = lod->first.x1;
+  seg.x1 = x;
+  seg.y1 = lod->first.y1;
+  seg.x2 = x;
+  seg.y2 = lod->min_y;
+  g_array_append_val (lod->segs, seg);
+  seg.y1 = lod->min_y;
+  seg.y2 = lod->max_y;
+  g_array_append_val (lod->segs, seg);
+  seg.y1 = lod->max_y;
+  seg.x2 = lod->last_x;
+  seg.y2 = lod->last_y;
+  g_array_append_val (lod->segs, seg);
+}
+
+static void
+lod_lines_add (lod_lines_t * lod, seg_t * seg)
+{
+  double col1, col2;
+
+  lod->num_added++;
+  if (lod->cell <= 0)
+    {
+      g_array_append_val (lod->segs, *seg);
+      return;
+    }
+
+  col1 = floor (seg->x1 / lod->cell);
+  col2 = floor (seg->x2 / lod->cell);
+
+  if (lod->in_run
+      && col1 == lod->col && col2 == lod->col
+      && seg->x1 == lod->last_x && seg->y1 == lod->last_y)
+    {
+      lod->num_in_run++;
+      lod->last_x = seg->x2;
+      lod->last_y = seg->y2;
+      if (seg->y2 < lod->min_y)
+	lod->min_y = seg->y2;
+      if (seg->y2 > lod->max_y)
+	lod->max_y = seg->y2;
+      return;
+    }
+
+  lod_lines_flush (lod);
+
+  /* Segments crossing columns are always kept as they are */
+  if (col1 != col2)
+    {
+      g_array_append_val (lod->segs, *seg);
+      return;
+    }
+
+  lod->in_run = TRUE;
+  lod->num_in_run = 1;
+  lod->col = col1;
+  lod->first = *seg;
+  lod->last_x = seg->x2;
+  lod->last_y = seg->y2;
+  lod->min_y = MIN (seg->y1, seg->y2);
+  lod->max_y = MAX (seg->y1, seg->y2);
+}
+
+static void
+lod_marks_init (lod_marks_t * lod, GArray * marks, double cell,
+		int width, int height)
+{
+  memset (lod, 0, sizeof (*lod));
+  lod->marks = marks;
+  lod->cell = cell;
+  if (cell > 0)
+    {
+      lod->ncols = (int) ceil (width / cell) + 1;
+      lod->nrows = (int) ceil (height / cell) + 1;
+      lod->occupied = g_new0 (guint8, (lod->ncols * lod->nrows + 7) / 8);
+    }
+}
+
+static void
+lod_marks_add (lod_marks_t * lod, mark_t * mark)
+{
+  int col, row, idx;
+
+  lod->num_added++;
+  if (lod->cell > 0)
+    {
+      col = (int) floor (mark->x / lod->cell);
+      row = (int) floor (mark->y / lod->cell);
+      if (col >= 0 && col < lod->ncols && row >= 0 && row < lod->nrows)
+	{
+	  idx = row * lod->ncols + col;
+	  if (lod->occupied[idx / 8] & (1 << (idx % 8)))
+	    return;
+	  lod->occupied[idx / 8] |= 1 << (idx % 8);
+	}
+    }
+  g_array_append_val (lod->marks, *mark);
+}
+
+/* How often the progress of drawing the data is reported */
+#define PROGRESS_MASK 0xffff
+
+/* Spilled datasets are drawn in batches of at most this many segments
+   or marks, so that they don't have to fit in memory at once */
+#define DRAW_BATCH_SIZE (1 << 20)
+
+/* Whether a chunk of a spilled dataset may be seen in the window,
+   given in the coordinates of the data */
+static gboolean
+spill_chunk_is_visible (const spill_chunk_t * chunk, double x0, double y0,
+			double x1, double y1)
+{
+  return chunk->x1 >= x0 && chunk->x0 <= x1
+    && chunk->y1 >= y0 && chunk->y0 <= y1;
+}
+
+/* The number of points from the idx'th on that are in a block of a
+   ring dataset outside of the window, or zero if idx doesn't start a
+   block */
+static guint
+ring_get_num_hidden (dataset_t * dataset, guint idx, double x0, double y0,
+		     double x1, double y1)
+{
+  guint slot = idx + dataset->ring_start;
+
+  if (slot >= dataset->ring_capacity)
+    slot -= dataset->ring_capacity;
+  if ((slot & (PYRAMID_BLOCK_SIZE - 1)) != 0
+      || gxgraph_pyramid_block_intersects (dataset->pyramid,
+					   slot >> PYRAMID_BLOCK_SHIFT,
+					   x0, y0, x1, y1))
+    return 0;
+
+  return MIN (PYRAMID_BLOCK_SIZE, dataset->ring_capacity - slot);
+}
+
+/* Points are transformed to log axes this many at a time */
+#define LOG_BLOCK_SIZE 256
+
+/* Replace values by their log10. Values that have no logarithm become
+   NaN or -inf. This is kept a plain loop over an array so that the
+   compiler can vectorize it. */
+static void
+log10_values (double *values, guint num_values)
+{
+  guint idx;
+
+  for (idx = 0; idx < num_values; idx++)
+    values[idx] = log10 (values[idx]);
+}
+
+/* The world coordinates of the points first to end - 1 of a dataset */
+static void
+get_world_points (window_t * window, dataset_t * dataset, guint first,
+		  guint end, double *xs, double *ys)
+{
+  guint idx;
+
+  for (idx = first; idx < end; idx++)
+    {
+      point_t p = dataset_get_point (dataset, idx);
+
+      xs[idx - first] = p.data.point.x;
+      ys[idx - first] = p.data.point.y;
+    }
+  if (window->do_logx)
+    log10_values (xs, end - first);
+  if (window->do_logy)
+    log10_values (ys, end - first);
+}
+
+/* Draw the segments and marks collected for a dataset and empty the
+   arrays for the next batch */
+static void
+draw_data_batch (painter_t * painter, GArray * seg_array,
+		 GArray * mark_array, gboolean do_draw_lines,
+		 gboolean do_draw_marks, glong * num_segs_drawn,
+		 glong * num_marks_drawn)
+{
+  if (do_draw_lines)
+    {
+      TRACE_BEGIN ("draw segments", NULL);
+      painter->group_start (painter, "lines");
+      painter->draw_segments (painter, seg_array);
+      painter->group_end (painter, "lines");
+      TRACE_END ("draw segments");
+    }
+  if (do_draw_marks)
+    {
+      TRACE_BEGIN ("draw marks", NULL);
+      painter->group_start (painter, "marks");
+      painter->draw_marks (painter, mark_array);
+      painter->group_end (painter, "marks");
+      TRACE_END ("draw marks");
+    }
+
+  *num_segs_drawn += seg_array->len;
+  *num_marks_drawn += mark_array->len;
+  g_array_set_size (seg_array, 0);
+  g_array_set_size (mark_array, 0);
+}
+
+/* Draw the points of the datasets between the world x0 and x1. With a
+   damage rectangle, only the points appended since the window was last
+   drawn by its gtk painter are drawn, and the rectangle is set to the
+   area that they cover. */
+static void
+draw_data (window_t * window, painter_t * painter, double x0, double x1,
+	   GdkRectangle * damage)
 {
   dataset_t *ds_p;
   double sx1, sy1, sx2, sy2, tx, ty;
   int code1, code2, cd, mark_inside;
   double scale_x = 1.0;
   double scale_y = 1.0;
+  double lod_cell = 0;
+  glong num_points = 0, num_done = 0;
+  GTimer *timer = NULL;
+  guint ds_idx;
+  gboolean do_log = window->do_logx || window->do_logy;
+  double data_org_x, data_org_y, data_opp_x, data_opp_y;
+  double damage_x0 = HUGE_VAL, damage_y0 = HUGE_VAL;
+  double damage_x1 = -HUGE_VAL, damage_y1 = -HUGE_VAL;
+  double damage_pad = 0;
+  gboolean do_record = window->num_drawn && painter == window->gtk_painter;
+
+  /* The window in the coordinates of the data */
+  data_org_x = window->do_logx ? pow (10, x0) : x0;
+  data_opp_x = window->do_logx ? pow (10, x1) : x1;
+  data_org_y = window->do_logy
+    ? pow (10, window->world_org_y) : window->world_org_y;
+  data_opp_y = window->do_logy
+    ? pow (10, window->world_opp_y) : window->world_opp_y;
+
+  if (painter->lod_dpi > 0 && painter->units_per_inch > 0)
+    lod_cell = painter->units_per_inch / painter->lod_dpi;
+
+  if (painter->progress)
+    for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+      num_points += dataset_get_num_points (g_ptr_array_index
+					    (window->datasets, ds_idx));
+
+  if (painter->stats)
+    timer = g_timer_new ();
 
   // TBD: If do_scale_marks is on, then the scale of the marks
   // should be adjusted.
-  for (ds_p = window->first_dataset; ds_p; ds_p = ds_p->next_dataset)
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
     {
-      int i;
+      guint i, start, end, num_alloc;
+      glong num_segments = 0;
+      glong num_segs_drawn = 0, num_marks_drawn = 0;
       gboolean do_draw_marks;
       gboolean do_draw_lines;
-      point_t prev_point = g_array_index (ds_p->points, point_t, 0);
-      GArray *seg_array = g_array_sized_new (FALSE,
-					     FALSE,
-					     sizeof (seg_t),
-					     ds_p->points->len);
-      GArray *mark_array = g_array_sized_new (FALSE,
-					      FALSE,
-					      sizeof (mark_t),
-					      ds_p->points->len);
+      double prev_x = 0, prev_y = 0;
+      gboolean has_prev = FALSE;
+      double block_x[LOG_BLOCK_SIZE], block_y[LOG_BLOCK_SIZE];
+      guint block_start = 0, block_end = 0;
+      GArray *seg_array;
+      GArray *mark_array;
+      lod_lines_t lod_lines;
+      lod_marks_t lod_marks;
+
+      ds_p = g_ptr_array_index (window->datasets, ds_idx);
+      if (ds_p->pyramid)
+	dataset_update_pyramid (ds_p);
+      dataset_get_visible_range (ds_p, data_org_x, data_opp_x, &start, &end);
+
+      /* Continue the line from the last point that was drawn */
+      if (damage)
+	{
+	  guint num_drawn = g_array_index (window->num_drawn, guint, ds_idx);
+
+	  if (num_drawn > start)
+	    {
+	      start = MIN (num_drawn, end);
+	      get_world_points (window, ds_p, start - 1, start, &prev_x,
+				&prev_y);
+	      has_prev = !do_log || (isfinite (prev_x) && isfinite (prev_y));
+	      if (has_prev && start < end)
+		{
+		  damage_x0 = MIN (damage_x0, prev_x);
+		  damage_x1 = MAX (damage_x1, prev_x);
+		  damage_y0 = MIN (damage_y0, prev_y);
+		  damage_y1 = MAX (damage_y1, prev_y);
+		}
+	    }
+	  damage_pad = MAX (damage_pad, ds_p->mark_size + ds_p->line_width);
+	}
+      num_alloc = end - start;
+      if (ds_p->spill)
+	num_alloc = MIN (num_alloc, DRAW_BATCH_SIZE);
+      seg_array = g_array_sized_new (FALSE, FALSE, sizeof (seg_t),
+				     num_alloc);
+      mark_array = g_array_sized_new (FALSE, FALSE, sizeof (mark_t),
+				      num_alloc);
+
+      if (timer)
+	g_timer_start (timer);
+      lod_lines_init (&lod_lines, seg_array, lod_cell);
+      lod_marks_init (&lod_marks, mark_array, lod_cell,
+		      painter->area_w, painter->area_h);
 
       do_draw_lines = ds_p->do_draw_lines == TRUE
 	|| (ds_p->do_draw_lines == DEFAULT && default_draw_lines);
@@ -1201,18 +3459,98 @@ gxgraph_draw_data (window_t * window, painter_t * painter)
 			       ds_p->mark_type,
 			       ds_p->mark_size * scale_x,
 			       ds_p->mark_size * scale_y);
-      for (i = 0; i < ds_p->points->len; i++)
+      if (do_draw_lines && do_draw_marks)
+	painter->group_start (painter, "lines_marks");
+
+      for (i = start; i < end; i++)
 	{
-	  point_t p = g_array_index (ds_p->points, point_t, i);
-	  double x = p.data.point.x;
-	  double y = p.data.point.y;
+	  point_t p;
+	  double x, y;
+	  guint num_hidden = 0;
+
+	  /* Skip the spill chunks outside of the window without paging
+	     them in, and the blocks of rings outside of the window */
+	  if (ds_p->spill && (i & (SPILL_CHUNK_SIZE - 1)) == 0
+	      && !spill_chunk_is_visible
+	      (gxgraph_spill_get_chunk (ds_p->spill, i >> SPILL_CHUNK_SHIFT),
+	       data_org_x, data_org_y, data_opp_x, data_opp_y))
+	    num_hidden = SPILL_CHUNK_SIZE;
+	  else if (ds_p->pyramid)
+	    num_hidden = ring_get_num_hidden (ds_p, i, data_org_x, data_org_y,
+					      data_opp_x, data_opp_y);
+	  if (num_hidden)
+	    {
+	      guint last = MIN (end, i + num_hidden) - 1;
 
-	  if (ds_p->do_draw_lines && i > 0 && p.op == OP_DRAW)
+	      num_done += last - i;
+	      i = last;
+	      get_world_points (window, ds_p, i, i + 1, &prev_x, &prev_y);
+	      has_prev = !do_log || (isfinite (prev_x) && isfinite (prev_y));
+	      continue;
+	    }
+
+	  /* Draw what has been collected from a spill file when the
+	     batch is full */
+	  if (ds_p->spill && (seg_array->len >= DRAW_BATCH_SIZE
+			      || mark_array->len >= DRAW_BATCH_SIZE))
+	    {
+	      lod_lines_flush (&lod_lines);
+	      draw_data_batch (painter, seg_array, mark_array,
+			       do_draw_lines, do_draw_marks,
+			       &num_segs_drawn, &num_marks_drawn);
+	    }
+
+	  p = dataset_get_point (ds_p, i);
+	  x = p.data.point.x;
+	  y = p.data.point.y;
+	  if (do_log)
+	    {
+	      if (i >= block_end)
+		{
+		  block_start = i;
+		  block_end = MIN (end, i + LOG_BLOCK_SIZE);
+		  get_world_points (window, ds_p, block_start, block_end,
+				    block_x, block_y);
+		}
+	      x = block_x[i - block_start];
+	      y = block_y[i - block_start];
+	    }
+
+	  if (painter->progress && (++num_done & PROGRESS_MASK) == 0
+	      && !painter->progress (painter, 1.0 * num_done / num_points))
+	    {
+	      g_array_free (seg_array, TRUE);
+	      g_array_free (mark_array, TRUE);
+	      g_free (lod_marks.occupied);
+	      if (timer)
+		g_timer_destroy (timer);
+	      if (do_draw_lines && do_draw_marks)
+		painter->group_end (painter, "lines_marks");
+	      return;
+	    }
+
+	  /* Values without a logarithm break the line */
+	  if (do_log && !(isfinite (x) && isfinite (y)))
+	    {
+	      has_prev = FALSE;
+	      continue;
+	    }
+
+	  if (damage)
+	    {
+	      damage_x0 = MIN (damage_x0, x);
+	      damage_x1 = MAX (damage_x1, x);
+	      damage_y0 = MIN (damage_y0, y);
+	      damage_y1 = MAX (damage_y1, y);
+	    }
+
+	  if (ds_p->do_draw_lines && has_prev && p.op == OP_DRAW)
 	    {
-	      sx1 = prev_point.data.point.x;
-	      sy1 = prev_point.data.point.y;
+	      sx1 = prev_x;
+	      sy1 = prev_y;
 	      sx2 = x;
 	      sy2 = y;
+	      num_segments++;
 
 	      C_CODE (sx1, sy1, code1);
 	      C_CODE (sx2, sy2, code2);
@@ -1273,7 +3611,7 @@ gxgraph_draw_data (window_t * window, painter_t * painter)
 		  seg.x2 = SCREENX (window, sx2);
 		  seg.y2 = SCREENY (window, sy2);
 
-		  g_array_append_val (seg_array, seg);
+		  lod_lines_add (&lod_lines, &seg);
 		}
 	    }
 
@@ -1285,25 +3623,50 @@ gxgraph_draw_data (window_t * window, painter_t * painter)
 	      mark_t mark;
 	      mark.x = SCREENX (window, x);
 	      mark.y = SCREENY (window, y);
-	      g_array_append_val (mark_array, mark);
+	      lod_marks_add (&lod_marks, &mark);
 	    }
-	  prev_point = p;
+	  prev_x = x;
+	  prev_y = y;
+	  has_prev = TRUE;
 	}
+      lod_lines_flush (&lod_lines);
+      g_free (lod_marks.occupied);
 
-      if (do_draw_lines && do_draw_marks)
-	painter->group_start (painter, "lines_marks");
+      draw_data_batch (painter, seg_array, mark_array, do_draw_lines,
+		       do_draw_marks, &num_segs_drawn, &num_marks_drawn);
 
-      if (do_draw_lines)
+      if (lod_cell > 0)
 	{
-	  painter->group_start (painter, "lines");
-	  painter->draw_segments (painter, seg_array);
-	  painter->group_end (painter, "lines");
+	  if (do_draw_lines)
+	    {
+	      painter->lod_num_primitives += lod_lines.num_added;
+	      painter->lod_num_dropped += lod_lines.num_added - num_segs_drawn;
+	    }
+	  if (do_draw_marks)
+	    {
+	      painter->lod_num_primitives += lod_marks.num_added;
+	      painter->lod_num_dropped += lod_marks.num_added - num_marks_drawn;
+	    }
 	}
-      if (do_draw_marks)
+
+      if (painter->stats)
 	{
-	  painter->group_start (painter, "marks");
-	  painter->draw_marks (painter, mark_array);
-	  painter->group_end (painter, "marks");
+	  dataset_stats_t ds_stats;
+
+	  ds_stats.seconds = g_timer_elapsed (timer, NULL);
+	  ds_stats.num_submitted = 0;
+	  ds_stats.num_drawn = 0;
+	  if (do_draw_lines)
+	    {
+	      ds_stats.num_submitted += num_segments;
+	      ds_stats.num_drawn += num_segs_drawn;
+	    }
+	  if (do_draw_marks)
+	    {
+	      ds_stats.num_submitted += end - start;
+	      ds_stats.num_drawn += num_marks_drawn;
+	    }
+	  g_array_append_val (painter->stats->datasets, ds_stats);
 	}
 
       g_array_free (seg_array, TRUE);
@@ -1312,7 +3675,188 @@ gxgraph_draw_data (window_t * window, painter_t * painter)
       if (do_draw_lines && do_draw_marks)
 	painter->group_end (painter, "lines_marks");
 
+      if (do_record)
+	{
+	  g_array_set_size (window->num_drawn, window->datasets->len);
+	  g_array_set_size (window->last_x_drawn, window->datasets->len);
+	  g_array_index (window->num_drawn, guint, ds_idx) =
+	    dataset_get_num_points (ds_p);
+	  g_array_index (window->last_x_drawn, double, ds_idx) = ds_p->last_x;
+	}
+    }
+
+  if (timer)
+    g_timer_destroy (timer);
+
+  /* The part of the window that the points reach, clipped to the axes */
+  if (damage)
+    {
+      damage_x0 = MAX (damage_x0, window->world_org_x);
+      damage_x1 = MIN (damage_x1, window->world_opp_x);
+      damage_y0 = MAX (damage_y0, window->world_org_y);
+      damage_y1 = MIN (damage_y1, window->world_opp_y);
+      damage->x = damage->y = damage->width = damage->height = 0;
+      if (damage_x0 <= damage_x1 && damage_y0 <= damage_y1)
+	{
+	  damage->x = floor (SCREENX (window, damage_x0) - damage_pad);
+	  damage->y = floor (SCREENY (window, damage_y1) - damage_pad);
+	  damage->width = ceil (SCREENX (window, damage_x1) + damage_pad)
+	    - damage->x + 1;
+	  damage->height = ceil (SCREENY (window, damage_y0) + damage_pad)
+	    - damage->y + 1;
+	}
+    }
+}
+
+void
+gxgraph_draw_data (window_t * window, painter_t * painter)
+{
+  draw_data (window, painter, window->world_org_x, window->world_opp_x,
+	     NULL);
+}
+
+/* Whether the gtk painter has drawn the datasets of the window, and
+   none of them have lost points since. Removing a set from the window
+   forgets what was drawn, and added sets make the lengths differ. */
+static gboolean
+window_has_drawn_datasets (window_t * window)
+{
+  guint ds_idx;
+
+  if (!window->num_drawn || window->num_drawn->len != window->datasets->len
+      || window->datasets->len == 0)
+    return FALSE;
+
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    if (dataset_get_num_points (g_ptr_array_index (window->datasets, ds_idx))
+	< g_array_index (window->num_drawn, guint, ds_idx))
+      return FALSE;
+
+  return TRUE;
+}
+
+/* Draw the points that have been appended to the datasets since the
+   window was last drawn, on top of what its gtk painter has drawn.
+   Returns FALSE without drawing if the window must be drawn in full,
+   as the datasets or the world have changed, or a full ring has
+   overwritten points that were drawn. */
+gboolean
+gxgraph_draw_appended (window_t * window, GdkRectangle * damage)
+{
+  painter_t *painter = window->gtk_painter;
+  GTimer *timer = NULL;
+  guint ds_idx;
+
+  if (!window_has_drawn_datasets (window))
+    return FALSE;
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    {
+      dataset_t *ds_p = g_ptr_array_index (window->datasets, ds_idx);
+
+      if (ds_p->ring_capacity
+	  && dataset_get_num_points (ds_p) == ds_p->ring_capacity)
+	return FALSE;
+    }
+
+  if (window->do_fit)
+    {
+      world_t world;
+
+      fit_world (window, &world);
+      if (world.x0 != window->world.x0 || world.x1 != window->world.x1
+	  || world.y0 != window->world.y0 || world.y1 != window->world.y1)
+	return FALSE;
+    }
+
+  if (painter->stats)
+    {
+      if (painter->stats->datasets)
+	g_array_set_size (painter->stats->datasets, 0);
+      painter->stats->seconds = painter->stats->text_seconds = 0;
+      painter->stats->grid_seconds = painter->stats->data_seconds = 0;
+      timer = g_timer_new ();
+    }
+
+  TRACE_BEGIN ("draw appended data", NULL);
+  draw_data (window, painter, window->world_org_x, window->world_opp_x,
+	     damage);
+  TRACE_END ("draw appended data");
+
+  if (timer)
+    {
+      painter->stats->seconds = painter->stats->data_seconds =
+	g_timer_elapsed (timer, NULL);
+      g_timer_destroy (timer);
+    }
+
+  return TRUE;
+}
+
+/* The number of pixels that a window showing a strip of the newest
+   points is to be scrolled left by to show the points appended since
+   it was last drawn, and the world that it then shows. Once scrolled,
+   the window must be drawn again from the screen column. Returns 0 if
+   the window must be drawn in full instead, as the datasets or the y
+   axis have changed, x decreases within a set, or a full ring has
+   overwritten points that are still shown. */
+int
+gxgraph_get_scroll (window_t * window, world_t * world, int *column)
+{
+  double shift, x_changed = HUGE_VAL, pad = 0;
+  guint ds_idx;
+
+  if (prm_strip_width <= 0 || !window->do_fit || window->do_logx
+      || window->opp_x <= window->org_x
+      || !window_has_drawn_datasets (window))
+    return 0;
+
+  fit_world (window, world);
+  shift = (world->x0 - window->world.x0) / window->world.scale_x;
+  if (world->y0 != window->world.y0 || world->y1 != window->world.y1
+      || fabs ((world->x1 - world->x0)
+	       - (window->world.x1 - window->world.x0))
+      > 1e-3 * window->world.scale_x
+      || shift < 0.5 || fabs (shift - floor (shift + 0.5)) > 1e-3
+      || axis_exponent (world->x0, world->x1, FALSE)
+      != axis_exponent (window->world.x0, window->world.x1, FALSE))
+    return 0;
+
+  for (ds_idx = 0; ds_idx < window->datasets->len; ds_idx++)
+    {
+      dataset_t *ds_p = g_ptr_array_index (window->datasets, ds_idx);
+      guint num_points = dataset_get_num_points (ds_p);
+      gboolean is_full = ds_p->ring_capacity
+	&& num_points == ds_p->ring_capacity;
+
+      if (!ds_p->is_sorted_x
+	  || (is_full
+	      && !(dataset_get_point (ds_p, 0).data.point.x < world->x0)))
+	return 0;
+
+      /* The new points continue from the last one that was drawn */
+      if (is_full
+	  || num_points != g_array_index (window->num_drawn, guint, ds_idx))
+	x_changed = MIN (x_changed,
+			 g_array_index (window->last_x_drawn, double, ds_idx));
+      pad = MAX (pad, ds_p->mark_size + ds_p->line_width);
     }
+
+  x_changed = MAX (MIN (x_changed, window->world_opp_x),
+		   window->world_org_x);
+  *column = (int) floor (SCREENX (window, x_changed) - pad - shift);
+
+  return (int) floor (shift + 0.5);
+}
+
+/* Draw the points of a window between the screen columns x0 and x1 */
+void
+gxgraph_draw_data_columns (window_t * window, painter_t * painter,
+			   double x0, double x1)
+{
+  draw_data (window, painter,
+	     window->world_org_x + (x0 - window->org_x) * window->world.scale_x,
+	     window->world_org_x + (x1 - window->org_x) * window->world.scale_x,
+	     NULL);
 }
 
 void
@@ -1337,8 +3881,13 @@ window_delete (window_t * window)
   window->gtk_painter = NULL;
 
   gtk_painter_delete (painter);
+  g_ptr_array_free (window->datasets, TRUE);
+  g_array_free (window->num_drawn, TRUE);
+  g_array_free (window->last_x_drawn, TRUE);
   free (window);
-  if (first_window == NULL)
+
+  /* The server keeps running without windows */
+  if (first_window == NULL && !prm_server_path)
     {
       gtk_main_quit ();
     }
@@ -1348,26 +3897,36 @@ window_delete (window_t * window)
 //  Grid support. This should be cleaned up.
 //----------------------------------------------------------------------
 */
-static double gridBase, gridStep, gridJuke[101];
-static int gridNJuke, gridCurJuke;
+/* Where we are when stepping through the ticks of an axis */
+typedef struct
+{
+  double base, step, juke[101];
+  int num_juke, cur_juke;
+} grid_stepper_t;
 
-#define ADD_GRID(val)	(gridJuke[gridNJuke++] = log10(val))
+/* Most ticks of an axis, in case of a degenerate step */
+#define MAX_GRID_TICKS 1000
 
-double
-init_grid (double low,		/* desired low value          */
+#define ADD_GRID(val)	(grid->juke[grid->num_juke++] = log10(val))
+
+static double step_grid (grid_stepper_t * grid);
+
+static double
+init_grid (grid_stepper_t * grid,
+	   double low,		/* desired low value          */
 	   double step,		/* desired step (user coords) */
 	   int logFlag)		/* is axis logarithmic?       */
 {
   double ratio, x;
 
-  gridNJuke = gridCurJuke = 0;
-  gridJuke[gridNJuke++] = 0.0;
+  grid->num_juke = grid->cur_juke = 0;
+  grid->juke[grid->num_juke++] = 0.0;
 
   if (logFlag)
     {
       ratio = pow (10.0, step);
-      gridBase = floor (low);
-      gridStep = ceil (step);
+      grid->base = floor (low);
+      grid->step = ceil (step);
       if (ratio <= 3.0)
 	{
 	  if (ratio > 2.0)
@@ -1410,7 +3969,7 @@ init_grid (double low,		/* desired low value          */
 		}
 	      if (x == 7.0)
 		{
-		  gridNJuke--;
+		  grid->num_juke--;
 		  x = 6.0;
 		}
 	      if (x < 7.0)
@@ -1418,32 +3977,49 @@ init_grid (double low,		/* desired low value          */
 		  ADD_GRID (x + 2.0);
 		}
 	      if (x == 10.0)
-		gridNJuke--;
+		grid->num_juke--;
 	    }
-	  x = low - gridBase;
-	  for (gridCurJuke = -1; x >= gridJuke[gridCurJuke + 1];
-	       gridCurJuke++)
+	  x = low - grid->base;
+	  for (grid->cur_juke = -1; x >= grid->juke[grid->cur_juke + 1];
+	       grid->cur_juke++)
 	    {
 	    }
 	}
     }
   else
     {
-      gridStep = round_up (step);
-      gridBase = floor (low / gridStep) * gridStep;
+      grid->step = round_up (step);
+      grid->base = floor (low / grid->step) * grid->step;
     }
-  return (step_grid ());
+  return (step_grid (grid));
 }
 
-double
-step_grid ()
+static double
+step_grid (grid_stepper_t * grid)
 {
-  if (++gridCurJuke >= gridNJuke)
+  if (++grid->cur_juke >= grid->num_juke)
     {
-      gridCurJuke = 0;
-      gridBase += gridStep;
+      grid->cur_juke = 0;
+      grid->base += grid->step;
     }
-  return (gridBase + gridJuke[gridCurJuke]);
+  return (grid->base + grid->juke[grid->cur_juke]);
+}
+
+/* The ticks of an axis from low to high, about step apart. The
+   stepping state is local so that windows may be drawn from several
+   threads at once. */
+static GArray *
+grid_ticks_new (double low, double high, double step, int logFlag)
+{
+  GArray *ticks = g_array_new (FALSE, FALSE, sizeof (double));
+  grid_stepper_t grid;
+  double tick;
+
+  for (tick = init_grid (&grid, low, step, logFlag);
+       tick < high && ticks->len < MAX_GRID_TICKS; tick = step_grid (&grid))
+    g_array_append_val (ticks, tick);
+
+  return ticks;
 }
 
 /*
@@ -62,6 +62,30 @@ typedef struct
   } data;
 } point_t;
 
+/* How the points of a dataset are stored */
+enum
+{
+  STORAGE_DOUBLE = 0,		/* point_t                               */
+  STORAGE_FLOAT = 1,		/* compact_point_t                       */
+  STORAGE_UNIFORM = 2,		/* gdouble y with x = origin_x + i*step_x */
+  STORAGE_UNIFORM_FLOAT = 3	/* gfloat y offset from origin_y         */
+};
+
+/* A point stored as a float offset from the origin of its dataset.
+   Text marks are kept in the text_marks array of the dataset. */
+typedef struct
+{
+  gint op;
+  union
+  {
+    struct
+    {
+      gfloat x, y;
+    } point;
+    guint text_idx;
+  } data;
+} compact_point_t;
+
 typedef struct
 {
   double x, y;
@@ -78,6 +102,7 @@ typedef struct
 
 typedef struct dataset_t
 {
+  guint id;			/* Index in the dataset table            */
   GdkColor color;
   GdkColor outline_color;
   gdouble line_width;
@@ -90,15 +115,93 @@ typedef struct dataset_t
   gboolean do_draw_lines;
   gboolean do_draw_polygon;
   gboolean do_draw_polygon_outline;
-  GArray *points;
+  gint storage;			/* STORAGE_DOUBLE or STORAGE_FLOAT       */
+  gdouble origin_x, origin_y;	/* Added to STORAGE_FLOAT points         */
+  gdouble step_x;		/* x spacing of STORAGE_UNIFORM points   */
+  GArray *points;		/* Element type depends on the storage   */
+  GPtrArray *text_marks;	/* Text marks of STORAGE_FLOAT datasets  */
+
+  /* Datasets that don't fit in memory keep their points in a spill
+     file instead of in the points array */
+  struct gxgraph_spill_t_struct *spill;
+  const gchar *spill_data;	/* The mapped points                     */
+  guint num_spill_points;
+
+  /* Ring datasets keep the last ring_capacity points. The oldest is
+     at ring_start, and the slots are overwritten in place. */
+  guint ring_capacity;
+  guint ring_start;
+  struct gxgraph_pyramid_t_struct *pyramid;	/* Boxes of the slots   */
+  struct gxgraph_arena_t_struct *arena;	/* Owns the strings and text marks */
   gchar *path_name;
   gchar *file_name;
   gchar *tree_path_string;
   gboolean is_visible;
   char *set_name;
-  struct dataset_t *next_dataset;
+  gboolean is_live;		/* Points are still being added          */
+  gboolean is_sorted_x;		/* The x of the points never decrease,
+				   as when x is time                     */
+  double last_x;		/* Of the last point appended            */
+
+  /* Bounding box of the points, and of their positive coordinates
+     on log axes. Computed when first needed. */
+  gboolean has_bbox, has_log_bbox;
+  double bbox_x0, bbox_x1, bbox_y0, bbox_y1;
+  double log_x0, log_x1, log_y0, log_y1;
 } dataset_t;
 
+static inline guint
+dataset_get_num_points (dataset_t * dataset)
+{
+  return dataset->spill ? dataset->num_spill_points : dataset->points->len;
+}
+
+/* The point at idx of a dataset, whatever its storage */
+static inline point_t
+dataset_get_point (dataset_t * dataset, guint idx)
+{
+  const gchar *data = dataset->spill
+    ? dataset->spill_data : dataset->points->data;
+  const compact_point_t *cp;
+  point_t p;
+
+  if (dataset->ring_capacity)
+    {
+      idx += dataset->ring_start;
+      if (idx >= dataset->ring_capacity)
+	idx -= dataset->ring_capacity;
+    }
+
+  switch (dataset->storage)
+    {
+    case STORAGE_DOUBLE:
+      return ((const point_t *) data)[idx];
+    case STORAGE_UNIFORM:
+      p.op = OP_DRAW;
+      p.data.point.x = dataset->origin_x + idx * dataset->step_x;
+      p.data.point.y = ((const gdouble *) data)[idx];
+      return p;
+    case STORAGE_UNIFORM_FLOAT:
+      p.op = OP_DRAW;
+      p.data.point.x = dataset->origin_x + idx * dataset->step_x;
+      p.data.point.y = dataset->origin_y + ((const gfloat *) data)[idx];
+      return p;
+    }
+
+  cp = &((const compact_point_t *) data)[idx];
+  p.op = cp->op;
+  if (cp->op == OP_TEXT)
+    p.data.text_object = g_ptr_array_index (dataset->text_marks,
+					    cp->data.text_idx);
+  else
+    {
+      p.data.point.x = dataset->origin_x + cp->data.point.x;
+      p.data.point.y = dataset->origin_y + cp->data.point.y;
+    }
+
+  return p;
+}
+
 typedef struct world_t
 {
   double x0, y0, x1, y1;	/* Bounding box of data in world */
@@ -109,6 +212,26 @@ typedef struct world_t
 
 } world_t;
 
+/* Time spent and primitives drawn for one dataset */
+typedef struct
+{
+  double seconds;
+  glong num_submitted;		/* Segments and marks before clipping    */
+  glong num_drawn;		/* Given to the painter after clipping
+				   and decimation                        */
+} dataset_stats_t;
+
+/* Statistics of the last time a window was drawn */
+typedef struct
+{
+  double seconds;		/* Total time                            */
+  double text_seconds;		/* Title and legend                      */
+  double grid_seconds;		/* Grid, axis and their labels           */
+  double data_seconds;		/* All the datasets                      */
+  GArray *datasets;		/* dataset_stats_t for each dataset      */
+  double lod_dpi;		/* Decimation resolution, 0 if off       */
+} render_stats_t;
+
 typedef struct painter_t_struct
 {
   void *user_data;
@@ -121,6 +244,22 @@ typedef struct painter_t_struct
   int axis_height;		/* Height of big character of axis font  */
   int title_width;		/* Width of big character of title font  */
   int title_height;		/* Height of big character of title font */
+  double units_per_inch;	/* Device units per inch                 */
+
+  /* Level of detail. When lod_dpi is non-zero, geometry is decimated
+     to one primitive per device pixel at that resolution before
+     it is given to the painter. */
+  double lod_dpi;
+  glong lod_num_primitives;	/* Primitives before decimation          */
+  glong lod_num_dropped;	/* Primitives removed by decimation      */
+
+  /* If set, called now and then while drawing the data with the
+     fraction done. Drawing stops if it returns FALSE. */
+  gboolean (*progress) (struct painter_t_struct * painter, double fraction);
+  gpointer progress_data;
+
+  /* If set, filled in by gxgraph_draw_window() */
+  render_stats_t *stats;
 
   void (*draw_segments) (struct painter_t_struct * painter,
 			 GArray * segments);
@@ -138,6 +277,11 @@ typedef struct painter_t_struct
 			  gint mark_type,
 			  gdouble mark_size_x, gdouble mark_size_y);
   void (*set_attributes_style) (struct painter_t_struct * painter, int style);
+  /* If set, measures a text in pixels as it is drawn. Otherwise the
+     size is estimated from axis_width and axis_height. */
+  void (*get_text_size) (struct painter_t_struct * painter,
+			 const char *text, int style,
+			 int *width, int *height);
   void (*group_start) (struct painter_t_struct * painter,
 		       const char *group_name);
   void (*group_end) (struct painter_t_struct * painter,
@@ -152,20 +296,91 @@ typedef struct window_t_struct
   double org_x, org_y, opp_x, opp_y;
   double world_org_x, world_org_y, world_opp_x, world_opp_y;
   world_t world;
+  gboolean do_logx, do_logy;	/* World coordinates are log10 of data   */
+  gboolean do_fit;		/* The world is fitted to the data       */
   struct window_t_struct *next_window;
   struct window_t_struct *previous_window;
-  dataset_t *first_dataset;
+  GPtrArray *datasets;		/* The datasets shown in the window      */
+  gboolean do_add_new_sets;	/* Sets added to the table later are
+				   shown too                             */
+  guint num_ids_seen;		/* The length of the table when they
+				   were last added                       */
+  GArray *num_drawn;		/* The number of points of each dataset
+				   on the backing store of gtk_painter   */
+  GArray *last_x_drawn;		/* The x of the last of these points     */
   painter_t *gtk_painter;
 } window_t;
 
+/* Parses the gxgraph text format into datasets, line by line */
+typedef struct loader_t_struct loader_t;
+
+typedef enum
+{
+  LOADER_FILE,			/* Read once                             */
+  LOADER_FOLLOW,		/* A file that keeps growing             */
+  LOADER_LIVE			/* A stream that switches between its
+				   sets by naming them                   */
+} loader_mode_t;
+
 typedef struct properties_t
 {
   int dum;
 } properties_t;
 
+/* All the datasets that have been read, indexed by their id. The
+   slot of a removed dataset is NULL so that the other ids stay valid. */
+extern GPtrArray *dataset_table;
+
+/* The number of sets read so far, which picks the color and default
+   name of the next one */
+extern int num_datasets;
+
+/* Plot settings of the command line, that the directives of the data
+   files may change */
+extern gchar *prm_title_text;
+extern gchar *prm_x_unit_text;
+extern gchar *prm_y_unit_text;
+extern gboolean default_draw_marks;
+
+void gxgraph_init ();
+void read_data_sets (int argc, char *argv[]);
+void finish_data_sets (guint first_id);
+loader_t *loader_new (const char *filename,
+		      struct gxgraph_arena_t_struct *arena,
+		      loader_mode_t mode);
+void loader_parse_line (loader_t * loader, const char *line);
+void loader_append_points (loader_t * loader, const char *set_name,
+			   const double *xy, guint num_points);
+void loader_remove_sets (loader_t * loader);
+void loader_free (loader_t * loader);
+void delete_data_sets ();
+void dataset_append_point (dataset_t * dataset, point_t * p);
+void dataset_set_storage (dataset_t * dataset, gint storage);
+void dataset_set_ring (dataset_t * dataset, guint capacity);
+gboolean dataset_make_uniform (dataset_t * dataset);
+dataset_t *dataset_table_lookup (guint id);
+void dataset_table_remove (dataset_t * dataset);
+void put_datasets_in_window (GPtrArray * datasets,
+			     window_t * window, world_t * world);
+window_t *new_headless_window (void);
 void gxgraph_draw_window (window_t * window, painter_t * painter);
+gboolean gxgraph_draw_appended (window_t * window, GdkRectangle * damage);
+int gxgraph_get_scroll (window_t * window, world_t * world, int *column);
+void gxgraph_draw_data_columns (window_t * window, painter_t * painter,
+				double x0, double x1);
+void gxgraph_draw_title (window_t * window, painter_t * painter);
+void gxgraph_draw_legend (window_t * window, painter_t * painter);
+void gxgraph_draw_grid_and_axis (window_t * window, painter_t * painter);
+void gxgraph_draw_data (window_t * window, painter_t * painter);
+int compute_transform (window_t * window, painter_t * painter);
+window_t *gxgraph_window_snapshot (window_t * window);
+void gxgraph_window_snapshot_free (window_t * snapshot);
 void window_delete (window_t * window);
 void gxgraph_add_window_with_world (window_t * previous_window,
 				    world_t * world);
+void gxgraph_add_window (GPtrArray * datasets, int width, int height);
+gboolean gxgraph_is_dataset_shown (dataset_t * dataset);
+void gxgraph_update_windows (void);
+void gxgraph_schedule_update (void);
 
 #endif
@@ -0,0 +1,117 @@
+/*======================================================================
+//  gxgraph_arena.c - An arena that owns the strings and text marks
+//  of the datasets read in one load.
+//
+//  Memory is handed out from large blocks and is only given back when
+//  the last reference to the arena goes away. Each dataset holds a
+//  reference to the arena of the load that read it.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <string.h>
+#include "gxgraph_arena.h"
+
+#define ARENA_BLOCK_SIZE 65536
+
+struct gxgraph_arena_t_struct
+{
+  gint ref_count;
+  GSList *blocks;
+  gchar *free_p;		/* Next free byte of the current block  */
+  gsize num_free;		/* Bytes left in the current block      */
+  gsize num_bytes;		/* Bytes in all blocks                  */
+};
+
+gxgraph_arena_t *
+gxgraph_arena_new (void)
+{
+  gxgraph_arena_t *arena = g_new0 (gxgraph_arena_t, 1);
+
+  arena->ref_count = 1;
+
+  return arena;
+}
+
+gxgraph_arena_t *
+gxgraph_arena_ref (gxgraph_arena_t * arena)
+{
+  g_atomic_int_inc (&arena->ref_count);
+
+  return arena;
+}
+
+void
+gxgraph_arena_unref (gxgraph_arena_t * arena)
+{
+  GSList *block;
+
+  if (!g_atomic_int_dec_and_test (&arena->ref_count))
+    return;
+
+  for (block = arena->blocks; block; block = block->next)
+    g_free (block->data);
+  g_slist_free (arena->blocks);
+  g_free (arena);
+}
+
+gpointer
+gxgraph_arena_alloc (gxgraph_arena_t * arena, gsize size)
+{
+  gpointer p;
+
+  size = (size + G_MEM_ALIGN - 1) & ~((gsize) G_MEM_ALIGN - 1);
+
+  /* Big allocations get a block of their own */
+  if (size > ARENA_BLOCK_SIZE / 4)
+    {
+      p = g_malloc (size);
+      arena->blocks = g_slist_prepend (arena->blocks, p);
+      arena->num_bytes += size;
+      return p;
+    }
+
+  if (size > arena->num_free)
+    {
+      arena->free_p = g_malloc (ARENA_BLOCK_SIZE);
+      arena->num_free = ARENA_BLOCK_SIZE;
+      arena->blocks = g_slist_prepend (arena->blocks, arena->free_p);
+      arena->num_bytes += ARENA_BLOCK_SIZE;
+    }
+
+  p = arena->free_p;
+  arena->free_p += size;
+  arena->num_free -= size;
+
+  return p;
+}
+
+gchar *
+gxgraph_arena_strndup (gxgraph_arena_t * arena, const char *string,
+		       gsize len)
+{
+  gchar *copy = gxgraph_arena_alloc (arena, len + 1);
+
+  memcpy (copy, string, len);
+  copy[len] = 0;
+
+  return copy;
+}
+
+gchar *
+gxgraph_arena_strdup (gxgraph_arena_t * arena, const char *string)
+{
+  if (!string)
+    return NULL;
+
+  return gxgraph_arena_strndup (arena, string, strlen (string));
+}
+
+/* Bytes held in blocks by the arena */
+gsize
+gxgraph_arena_get_size (gxgraph_arena_t * arena)
+{
+  return arena->num_bytes;
+}
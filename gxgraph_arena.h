@@ -0,0 +1,26 @@
+/*======================================================================
+//  gxgraph_arena.h - An arena that owns the strings and text marks
+//  of the datasets read in one load.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_ARENA_H
+#define GXGRAPH_ARENA_H
+
+#include <glib.h>
+
+typedef struct gxgraph_arena_t_struct gxgraph_arena_t;
+
+gxgraph_arena_t *gxgraph_arena_new (void);
+gxgraph_arena_t *gxgraph_arena_ref (gxgraph_arena_t * arena);
+void gxgraph_arena_unref (gxgraph_arena_t * arena);
+gpointer gxgraph_arena_alloc (gxgraph_arena_t * arena, gsize size);
+gchar *gxgraph_arena_strdup (gxgraph_arena_t * arena, const char *string);
+gchar *gxgraph_arena_strndup (gxgraph_arena_t * arena, const char *string,
+			      gsize len);
+gsize gxgraph_arena_get_size (gxgraph_arena_t * arena);
+
+#endif /* GXGRAPH_ARENA */
@@ -0,0 +1,360 @@
+/*======================================================================
+//  gxgraph_bench.c - Benchmarks of the gxgraph rendering stages.
+//
+//  Generates synthetic datasets and times parsing, bounding box,
+//  layout, grid, data transformation and each of the painters
+//  separately. The results are written as JSON.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <glib/gstdio.h>
+#include "gxgraph.h"
+#include "cairo_painter.h"
+#include "ps_painter.h"
+#include "svg_painter.h"
+#include "null_painter.h"
+#include "version.h"
+
+typedef enum
+{
+  WORKLOAD_TIME_SERIES,
+  WORKLOAD_SCATTER,
+  WORKLOAD_MANY_SETS,
+  WORKLOAD_TEXT_HEAVY
+} workload_type_t;
+
+typedef struct
+{
+  const char *name;
+  workload_type_t type;
+  int num_points;
+} workload_t;
+
+static workload_t workloads[] = {
+  {"time_series", WORKLOAD_TIME_SERIES, 1000000},
+  {"scatter", WORKLOAD_SCATTER, 200000},
+  {"many_sets", WORKLOAD_MANY_SETS, 200000},
+  {"text_heavy", WORKLOAD_TEXT_HEAVY, 50000},
+};
+
+static int num_repeats = 3;
+static gboolean is_first_stage;
+
+/*======================================================================
+//  Synthetic data.
+//----------------------------------------------------------------------
+*/
+static void
+write_workload (workload_t * workload, const char *filename)
+{
+  FILE *OUT = fopen (filename, "w");
+  GRand *rand = g_rand_new_with_seed (42);
+  double y = 0;
+  int i;
+
+  if (!OUT)
+    {
+      fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+      exit (1);
+    }
+
+  switch (workload->type)
+    {
+    case WORKLOAD_TIME_SERIES:
+      for (i = 0; i < workload->num_points; i++)
+	{
+	  y += g_rand_double_range (rand, -1, 1);
+	  fprintf (OUT, "%d %.6f\n", i, y);
+	}
+      break;
+    case WORKLOAD_SCATTER:
+      fprintf (OUT, "$marks fcircle\n$noline\n");
+      for (i = 0; i < workload->num_points; i++)
+	fprintf (OUT, "%.6f %.6f\n",
+		 g_rand_double (rand), g_rand_double (rand));
+      break;
+    case WORKLOAD_MANY_SETS:
+      for (i = 0; i < workload->num_points; i++)
+	{
+	  if (i % 50 == 0)
+	    fprintf (OUT, "\n\"Set %d\n", i / 50);
+	  fprintf (OUT, "%d %.6f\n", i % 50,
+		   i / 50 + g_rand_double (rand));
+	}
+      break;
+    case WORKLOAD_TEXT_HEAVY:
+      for (i = 0; i < workload->num_points; i++)
+	{
+	  if (i % 100 == 0)
+	    fprintf (OUT, "\n\"A rather long name of the set number %d\n",
+		     i / 100);
+	  fprintf (OUT, "# Measurement %d of a long series of comments "
+		   "that describe the data in words\n", i);
+	  fprintf (OUT, "m %d %.6f\n", i, g_rand_double (rand));
+	}
+      break;
+    }
+
+  fclose (OUT);
+  g_rand_free (rand);
+}
+
+/*======================================================================
+//  Timing and output.
+//----------------------------------------------------------------------
+*/
+static glong
+file_size (const char *filename)
+{
+  struct stat st;
+
+  if (g_stat (filename, &st) != 0)
+    return 0;
+
+  return st.st_size;
+}
+
+static glong
+count_points ()
+{
+  glong num_points = 0;
+  guint id;
+
+  for (id = 0; id < dataset_table->len; id++)
+    if (dataset_table_lookup (id))
+      num_points += dataset_get_num_points (dataset_table_lookup (id));
+
+  return num_points;
+}
+
+static void
+print_stage (const char *stage, double seconds, glong num_points,
+	     glong num_bytes)
+{
+  printf ("%s\n        {\"stage\": \"%s\", \"seconds\": %.6g",
+	  is_first_stage ? "" : ",", stage, seconds);
+  if (seconds > 0)
+    {
+      printf (", \"points_per_s\": %.6g", num_points / seconds);
+      if (num_bytes > 0)
+	printf (", \"bytes_per_s\": %.6g", num_bytes / seconds);
+    }
+  if (num_bytes > 0)
+    printf (", \"bytes\": %ld", num_bytes);
+  printf ("}");
+  is_first_stage = FALSE;
+}
+
+typedef void (*stage_func_t) (window_t * window, painter_t * painter);
+
+/* Best time of num_repeats runs of a drawing stage */
+static double
+time_stage (stage_func_t func, window_t * window, painter_t * painter)
+{
+  GTimer *timer = g_timer_new ();
+  double best = HUGE_VAL;
+  int i;
+
+  for (i = 0; i < num_repeats; i++)
+    {
+      g_timer_start (timer);
+      func (window, painter);
+      g_timer_stop (timer);
+      best = MIN (best, g_timer_elapsed (timer, NULL));
+    }
+  g_timer_destroy (timer);
+
+  return best;
+}
+
+static void
+draw_layout (window_t * window, painter_t * painter)
+{
+  compute_transform (window, painter);
+}
+
+/* Time a painter writing to a file, once per repeat */
+static void
+bench_file_painter (const char *stage, window_t * window,
+		    const char *filename,
+		    painter_t * (*painter_new) (window_t *, const char *),
+		    void (*painter_delete) (painter_t *), glong num_points)
+{
+  GTimer *timer = g_timer_new ();
+  double best = HUGE_VAL;
+  int i;
+
+  for (i = 0; i < num_repeats; i++)
+    {
+      painter_t *painter;
+
+      g_timer_start (timer);
+      painter = painter_new (window, filename);
+      if (!painter)
+	{
+	  fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+	  exit (1);
+	}
+      gxgraph_draw_window (window, painter);
+      painter_delete (painter);
+      g_timer_stop (timer);
+      best = MIN (best, g_timer_elapsed (timer, NULL));
+    }
+  g_timer_destroy (timer);
+
+  print_stage (stage, best, num_points, file_size (filename));
+  g_unlink (filename);
+}
+
+static void
+bench_workload (workload_t * workload, const char *dir)
+{
+  gchar *data_filename = g_strdup_printf ("%s/%s.dat", dir, workload->name);
+  gchar *ps_filename = g_strdup_printf ("%s/%s.ps", dir, workload->name);
+  gchar *svg_filename = g_strdup_printf ("%s/%s.svg", dir, workload->name);
+  char *argv[1];
+  window_t *window;
+  painter_t *painter;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  GTimer *timer = g_timer_new ();
+  glong num_points, num_bytes;
+  double seconds;
+
+  write_workload (workload, data_filename);
+  num_bytes = file_size (data_filename);
+
+  /* Parse */
+  argv[0] = data_filename;
+  g_timer_start (timer);
+  read_data_sets (1, argv);
+  seconds = g_timer_elapsed (timer, NULL);
+  num_points = count_points ();
+
+  printf ("    {\"workload\": \"%s\", \"points\": %ld, \"bytes\": %ld,\n"
+	  "     \"stages\": [", workload->name, num_points, num_bytes);
+  is_first_stage = TRUE;
+  print_stage ("parse", seconds, num_points, num_bytes);
+
+  /* Bounding box */
+  window = new_headless_window ();
+  g_timer_start (timer);
+  put_datasets_in_window (dataset_table, window, NULL);
+  print_stage ("bbox", g_timer_elapsed (timer, NULL), num_points, 0);
+
+  /* Layout, grid and data without any drawing */
+  painter = null_painter_new (window);
+  print_stage ("layout", time_stage (draw_layout, window, painter),
+	       num_points, 0);
+  print_stage ("grid", time_stage (gxgraph_draw_grid_and_axis, window,
+				   painter), num_points, 0);
+  print_stage ("data", time_stage (gxgraph_draw_data, window, painter),
+	       num_points, 0);
+  null_painter_delete (painter);
+
+  /* The screen painter draws with cairo on an offscreen pixmap */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+					window->width, window->height);
+  cr = cairo_create (surface);
+  painter = cairo_painter_new (window, cr);
+  compute_transform (window, painter);
+  print_stage ("painter_gtk_offscreen",
+	       time_stage (gxgraph_draw_window, window, painter),
+	       num_points, 0);
+  cairo_painter_delete (painter);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+
+  bench_file_painter ("painter_ps", window, ps_filename,
+		      ps_painter_new, ps_painter_delete, num_points);
+  bench_file_painter ("painter_svg", window, svg_filename,
+		      svg_painter_new, svg_painter_delete, num_points);
+
+  printf ("]}");
+
+  delete_data_sets ();
+  g_ptr_array_free (window->datasets, TRUE);
+  g_free (window);
+  g_unlink (data_filename);
+  g_free (data_filename);
+  g_free (ps_filename);
+  g_free (svg_filename);
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *only = NULL;
+  double scale = 1.0;
+  gchar *dir;
+  int argp = 1;
+  int i, num_done = 0;
+
+  while (argp < argc && argv[argp][0] == '-')
+    {
+      char *S_ = argv[argp++];
+
+      if (strcmp (S_, "-help") == 0)
+	{
+	  printf ("gxgraph_bench - Benchmarks of gxgraph\n"
+		  "\n"
+		  "Syntax:\n"
+		  "    gxgraph_bench [-scale f] [-repeat n] [-only workload]\n"
+		  "\n"
+		  "The results are written to stdout as JSON.\n");
+	  exit (0);
+	}
+      else if (strcmp (S_, "-scale") == 0 && argp < argc)
+	scale = atof (argv[argp++]);
+      else if (strcmp (S_, "-repeat") == 0 && argp < argc)
+	num_repeats = MAX (atoi (argv[argp++]), 1);
+      else if (strcmp (S_, "-only") == 0 && argp < argc)
+	only = argv[argp++];
+      else
+	{
+	  fprintf (stderr, "Unknown option %s!\n", S_);
+	  exit (1);
+	}
+    }
+
+#if !GLIB_CHECK_VERSION(2,36,0)
+  g_type_init ();
+#endif
+  gxgraph_init ();
+
+  dir = g_dir_make_tmp ("gxgraph_bench_XXXXXX", NULL);
+  if (!dir)
+    {
+      fprintf (stderr, "Couldn't create a temporary directory!\n");
+      exit (1);
+    }
+
+  printf ("{\"version\": \"%s\", \"scale\": %g, \"repeats\": %d,\n"
+	  " \"workloads\": [\n", VERSION, scale, num_repeats);
+  for (i = 0; i < G_N_ELEMENTS (workloads); i++)
+    {
+      workload_t workload = workloads[i];
+
+      if (only && strcmp (only, workload.name) != 0)
+	continue;
+      workload.num_points = MAX ((int) (workload.num_points * scale), 1);
+      if (num_done++)
+	printf (",\n");
+      bench_workload (&workload, dir);
+    }
+  printf ("\n]}\n");
+
+  g_rmdir (dir);
+  g_free (dir);
+
+  return 0;
+}
@@ -0,0 +1,328 @@
+/*======================================================================
+//  gxgraph_export.c - Render a window to a file without a display.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include <png.h>
+#include "gxgraph.h"
+#include "gxgraph_export.h"
+#include "cairo_painter.h"
+#include "svg_painter.h"
+#include "gxgraph_trace.h"
+
+static double lod_dpi = 0;
+static int tile_height = 0;
+static int tile_num_threads = 1;
+
+/* PNG images with more pixels than this are always rendered in tiles */
+#define MAX_UNTILED_PIXELS (4096 * 4096)
+#define DEFAULT_TILE_HEIGHT 256
+
+/* Decimate the data of all following exports to the given resolution.
+   Zero turns decimation off. */
+void
+gxgraph_export_set_lod_dpi (double dpi)
+{
+  lod_dpi = dpi;
+}
+
+/* Render PNG images in horizontal bands of the given height, using up
+   to num_threads threads. A tile_height of zero only tiles images that
+   are too big to be rendered in one piece. */
+void
+gxgraph_export_set_tiling (int height, int num_threads)
+{
+  tile_height = height;
+  tile_num_threads = MAX (num_threads, 1);
+}
+
+export_format_t
+gxgraph_export_format_from_filename (const char *filename)
+{
+  const char *dot = strrchr (filename, '.');
+
+  if (dot == NULL)
+    return EXPORT_FORMAT_UNKNOWN;
+  if (g_ascii_strcasecmp (dot, ".png") == 0)
+    return EXPORT_FORMAT_PNG;
+  if (g_ascii_strcasecmp (dot, ".pdf") == 0)
+    return EXPORT_FORMAT_PDF;
+  if (g_ascii_strcasecmp (dot, ".svg") == 0)
+    return EXPORT_FORMAT_SVG;
+  if (g_ascii_strcasecmp (dot, ".ps") == 0)
+    return EXPORT_FORMAT_POSTSCRIPT;
+  if (g_ascii_strcasecmp (dot, ".eps") == 0)
+    return EXPORT_FORMAT_EPS;
+
+  return EXPORT_FORMAT_UNKNOWN;
+}
+
+static void
+print_lod_report (glong num_dropped, glong num_primitives)
+{
+  if (lod_dpi > 0)
+    fprintf (stderr, "Decimating at %g dpi dropped %ld of %ld primitives\n",
+	     lod_dpi, num_dropped, num_primitives);
+}
+
+/* Lay out the window for the painter and draw it */
+static int
+export_draw (window_t * window, painter_t * painter)
+{
+  int ret;
+
+  TRACE_BEGIN ("compute transform", NULL);
+  ret = compute_transform (window, painter);
+  TRACE_END ("compute transform");
+  if (ret != 0)
+    return -1;
+
+  painter->lod_dpi = lod_dpi;
+
+  gxgraph_draw_window (window, painter);
+  print_lod_report (painter->lod_num_dropped, painter->lod_num_primitives);
+
+  return 0;
+}
+
+/* A horizontal band of a tiled image */
+typedef struct
+{
+  window_t *window;
+  cairo_surface_t *surface;
+  int y0, height;
+  GThread *thread;
+  glong lod_num_primitives;	/* Of all the rounds of the band         */
+  glong lod_num_dropped;
+} export_band_t;
+
+static gpointer
+render_band (gpointer data)
+{
+  export_band_t *band = data;
+  cairo_t *cr = cairo_create (band->surface);
+  painter_t *painter;
+
+  cairo_set_source_rgb (cr, 1, 1, 1);
+  cairo_paint (cr);
+
+  /* Draw the full canvas clipped to the band */
+  cairo_translate (cr, 0, -band->y0);
+  cairo_rectangle (cr, 0, band->y0, band->window->width, band->height);
+  cairo_clip (cr);
+
+  painter = cairo_painter_new (band->window, cr);
+  painter->lod_dpi = lod_dpi;
+  TRACE_BEGIN ("render band", NULL);
+  gxgraph_draw_window (band->window, painter);
+  TRACE_END ("render band");
+  band->lod_num_primitives += painter->lod_num_primitives;
+  band->lod_num_dropped += painter->lod_num_dropped;
+  cairo_painter_delete (painter);
+  cairo_destroy (cr);
+
+  return NULL;
+}
+
+/* Render a PNG image band by band and stream the rows to the file, so
+   that the memory used only depends on the band size. */
+static int
+export_png_tiled (window_t * window, const char *filename, int band_height)
+{
+  int width = window->width;
+  int height = window->height;
+  int num_bands = tile_num_threads;
+  export_band_t *bands;
+  png_structp png = NULL;
+  png_infop png_info = NULL;
+  guchar *row = NULL;
+  cairo_surface_t *surface;
+  painter_t *painter;
+  cairo_t *cr;
+  FILE *OUT;
+  int ret = 0;
+  int y, i;
+
+  /* The layout is computed once for the whole canvas */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, 1, 1);
+  cr = cairo_create (surface);
+  painter = cairo_painter_new (window, cr);
+  ret = compute_transform (window, painter);
+  cairo_painter_delete (painter);
+  cairo_destroy (cr);
+  cairo_surface_destroy (surface);
+  if (ret != 0)
+    return -1;
+
+  OUT = fopen (filename, "wb");
+  if (!OUT)
+    {
+      fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+      return -1;
+    }
+
+  bands = g_new0 (export_band_t, num_bands);
+  for (i = 0; i < num_bands; i++)
+    {
+      bands[i].window = window;
+      bands[i].surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+						     width, band_height);
+    }
+  row = g_new (guchar, 3 * width);
+
+  png = png_create_write_struct (PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (png)
+    png_info = png_create_info_struct (png);
+  if (!png_info || setjmp (png_jmpbuf (png)))
+    {
+      fprintf (stderr, "Failed writing %s!\n", filename);
+      ret = -1;
+      goto done;
+    }
+
+  png_init_io (png, OUT);
+  png_set_IHDR (png, png_info, width, height, 8, PNG_COLOR_TYPE_RGB,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		PNG_FILTER_TYPE_DEFAULT);
+  png_write_info (png, png_info);
+
+  for (y = 0; y < height; y += num_bands * band_height)
+    {
+      int num_active = 0;
+
+      /* Render a round of bands in parallel */
+      for (i = 0; i < num_bands && y + i * band_height < height; i++)
+	{
+	  bands[i].y0 = y + i * band_height;
+	  bands[i].height = MIN (band_height, height - bands[i].y0);
+	  num_active++;
+	}
+
+      if (num_active == 1)
+	render_band (&bands[0]);
+      else
+	{
+	  for (i = 0; i < num_active; i++)
+#if GLIB_CHECK_VERSION(2,32,0)
+	    bands[i].thread = g_thread_new ("band", render_band, &bands[i]);
+#else
+	    bands[i].thread = g_thread_create (render_band, &bands[i], TRUE,
+					       NULL);
+#endif
+	  for (i = 0; i < num_active; i++)
+	    g_thread_join (bands[i].thread);
+	}
+
+      /* And write their rows in order */
+      TRACE_BEGIN ("write bands", NULL);
+      for (i = 0; i < num_active; i++)
+	{
+	  guchar *data;
+	  int stride;
+	  int r, c;
+
+	  cairo_surface_flush (bands[i].surface);
+	  data = cairo_image_surface_get_data (bands[i].surface);
+	  stride = cairo_image_surface_get_stride (bands[i].surface);
+
+	  for (r = 0; r < bands[i].height; r++)
+	    {
+	      guint32 *pixels = (guint32 *) (data + r * stride);
+
+	      for (c = 0; c < width; c++)
+		{
+		  row[3 * c] = (pixels[c] >> 16) & 0xff;
+		  row[3 * c + 1] = (pixels[c] >> 8) & 0xff;
+		  row[3 * c + 2] = pixels[c] & 0xff;
+		}
+	      png_write_row (png, row);
+	    }
+	}
+      TRACE_END ("write bands");
+    }
+
+  png_write_end (png, png_info);
+
+  /* Every band decimates the data that it is clipped from */
+  {
+    glong num_primitives = 0, num_dropped = 0;
+
+    for (i = 0; i < num_bands; i++)
+      {
+	num_primitives += bands[i].lod_num_primitives;
+	num_dropped += bands[i].lod_num_dropped;
+      }
+    print_lod_report (num_dropped, num_primitives);
+  }
+
+done:
+  png_destroy_write_struct (&png, &png_info);
+  for (i = 0; i < num_bands; i++)
+    cairo_surface_destroy (bands[i].surface);
+  g_free (bands);
+  g_free (row);
+  if (fclose (OUT) != 0)
+    ret = -1;
+
+  return ret;
+}
+
+int
+gxgraph_export (window_t * window, const char *filename)
+{
+  export_format_t format = gxgraph_export_format_from_filename (filename);
+  cairo_painter_format_t cairo_format = CAIRO_PAINTER_FORMAT_NONE;
+  painter_t *painter;
+  int ret;
+
+  switch (format)
+    {
+    case EXPORT_FORMAT_PNG:
+      if (tile_height > 0)
+	return export_png_tiled (window, filename, tile_height);
+      if ((gint64) window->width * window->height > MAX_UNTILED_PIXELS)
+	return export_png_tiled (window, filename, DEFAULT_TILE_HEIGHT);
+      cairo_format = CAIRO_PAINTER_FORMAT_PNG;
+      break;
+    case EXPORT_FORMAT_PDF:
+      cairo_format = CAIRO_PAINTER_FORMAT_PDF;
+      break;
+    case EXPORT_FORMAT_POSTSCRIPT:
+      cairo_format = CAIRO_PAINTER_FORMAT_PS;
+      break;
+    case EXPORT_FORMAT_EPS:
+      cairo_format = CAIRO_PAINTER_FORMAT_EPS;
+      break;
+    case EXPORT_FORMAT_SVG:
+      /* The svg painter gives much smaller files than cairo */
+      painter = svg_painter_new (window, filename);
+      if (!painter)
+	break;
+      ret = export_draw (window, painter);
+      svg_painter_delete (painter);
+      return ret;
+    default:
+      fprintf (stderr, "Unknown output format for %s!\n", filename);
+      return -1;
+    }
+
+  if (cairo_format != CAIRO_PAINTER_FORMAT_NONE)
+    {
+      painter = cairo_painter_new_for_file (window, filename, cairo_format);
+      if (painter)
+	{
+	  ret = export_draw (window, painter);
+	  if (cairo_painter_delete (painter) != 0)
+	    ret = -1;
+	  return ret;
+	}
+    }
+
+  fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+  return -1;
+}
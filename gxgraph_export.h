@@ -0,0 +1,29 @@
+/*======================================================================
+//  gxgraph_export.h - Render a window to a file without a display.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_EXPORT_H
+#define GXGRAPH_EXPORT_H
+
+#include "gxgraph.h"
+
+typedef enum
+{
+  EXPORT_FORMAT_UNKNOWN = -1,
+  EXPORT_FORMAT_PNG,
+  EXPORT_FORMAT_PDF,
+  EXPORT_FORMAT_SVG,
+  EXPORT_FORMAT_POSTSCRIPT,
+  EXPORT_FORMAT_EPS
+} export_format_t;
+
+export_format_t gxgraph_export_format_from_filename (const char *filename);
+int gxgraph_export (window_t * window, const char *filename);
+void gxgraph_export_set_lod_dpi (double dpi);
+void gxgraph_export_set_tiling (int height, int num_threads);
+
+#endif /* GXGRAPH_EXPORT */
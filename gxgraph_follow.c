@@ -0,0 +1,326 @@
+/*======================================================================
+//  gxgraph_follow.c - Follow data files that are still being written,
+//  and show what is appended to them while the windows are shown.
+//
+//  Each file keeps its loader, so that only the bytes appended since
+//  it was last read are parsed, and they continue the current set
+//  with its attributes. A file that is truncated or replaced by
+//  another is read again from the start. The directories of the files
+//  are watched with inotify where it is available, and the files are
+//  polled otherwise. Windows has no inode numbers, so there a file
+//  that is replaced is only seen when it is shorter than before.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "gxgraph.h"
+#include "gxgraph_arena.h"
+#include "gxgraph_follow.h"
+
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#define HAVE_INOTIFY
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define FOLLOW_READ_SIZE 65536
+
+/* Longest line, as for the data files that aren't followed */
+#define FOLLOW_MAX_LINE 256
+
+/* Milliseconds between the checks of the files without inotify */
+#define FOLLOW_POLL_INTERVAL 500
+
+typedef struct
+{
+  gchar *filename;
+  gchar *basename;
+  loader_t *loader;
+  GString *pending;		/* The start of a line that is still
+				   being written                         */
+  off_t offset;			/* Bytes read so far                     */
+  dev_t dev;			/* The file that was read                */
+  ino_t ino;
+  int watch_descriptor;		/* Of the directory of the file          */
+} follow_file_t;
+
+static GPtrArray *files = NULL;
+static guint poll_id = 0;
+#ifdef HAVE_INOTIFY
+static GIOChannel *inotify_channel = NULL;
+static guint inotify_watch_id = 0;
+#endif
+
+/* Parse the lines that have been read in full */
+static void
+follow_file_parse (follow_file_t * file)
+{
+  const gchar *data = file->pending->str;
+  gsize len = file->pending->len;
+  gsize pos = 0;
+
+  while (pos < len)
+    {
+      char S_[FOLLOW_MAX_LINE];
+      const gchar *newline = memchr (data + pos, '\n',
+				     MIN (len - pos, sizeof (S_) - 1));
+      gsize line_len;
+
+      /* Long lines are split like fgets() does */
+      if (newline)
+	line_len = newline - (data + pos) + 1;
+      else if (len - pos >= sizeof (S_) - 1)
+	line_len = sizeof (S_) - 1;
+      else
+	break;
+
+      memcpy (S_, data + pos, line_len);
+      S_[line_len] = '\0';
+      loader_parse_line (file->loader, S_);
+      pos += line_len;
+    }
+
+  g_string_erase (file->pending, 0, pos);
+}
+
+/* Read from the offset of a file, with a seek where there is no
+   pread() */
+static ssize_t
+follow_pread (int fd, gchar * buf, gsize len, off_t offset)
+{
+#ifdef G_OS_UNIX
+  return pread (fd, buf, len, offset);
+#else
+  if (lseek (fd, offset, SEEK_SET) < 0)
+    return -1;
+  return read (fd, buf, len);
+#endif
+}
+
+/* Read what has been appended to a file since it was last read.
+   Returns whether the datasets have changed. */
+static gboolean
+follow_file_read (follow_file_t * file)
+{
+  gchar buf[FOLLOW_READ_SIZE];
+  gboolean has_changed = FALSE;
+  struct stat st;
+  ssize_t num_read;
+  int fd;
+
+  /* The file may not have been created yet, or be in the middle of
+     being replaced */
+  fd = open (file->filename, O_RDONLY | O_BINARY);
+  if (fd < 0)
+    return FALSE;
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return FALSE;
+    }
+
+  if (file->offset > 0
+      && (st.st_dev != file->dev || st.st_ino != file->ino
+	  || st.st_size < file->offset))
+    {
+      loader_remove_sets (file->loader);
+      g_string_truncate (file->pending, 0);
+      file->offset = 0;
+      has_changed = TRUE;
+    }
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+
+  while ((num_read = follow_pread (fd, buf, sizeof (buf), file->offset)) > 0)
+    {
+      g_string_append_len (file->pending, buf, num_read);
+      file->offset += num_read;
+      follow_file_parse (file);
+      has_changed = TRUE;
+    }
+  if (num_read < 0)
+    fprintf (stderr, "Warning! Couldn't read %s: %s\n", file->filename,
+	     g_strerror (errno));
+  close (fd);
+
+  return has_changed;
+}
+
+static gboolean
+cb_poll (gpointer user_data)
+{
+  gboolean has_changed = FALSE;
+  guint idx;
+
+  for (idx = 0; idx < files->len; idx++)
+    if (follow_file_read (g_ptr_array_index (files, idx)))
+      has_changed = TRUE;
+  if (has_changed)
+    gxgraph_schedule_update ();
+
+  return TRUE;
+}
+
+#ifdef HAVE_INOTIFY
+static gboolean
+cb_inotify (GIOChannel * channel, GIOCondition condition, gpointer user_data)
+{
+  gchar buf[4096]
+    __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+  int fd = g_io_channel_unix_get_fd (channel);
+  gboolean has_changed = FALSE;
+  ssize_t len;
+
+  while ((len = read (fd, buf, sizeof (buf))) > 0)
+    {
+      ssize_t pos;
+
+      for (pos = 0; pos < len;
+	   pos += sizeof (struct inotify_event)
+	   + ((struct inotify_event *) (buf + pos))->len)
+	{
+	  struct inotify_event *event = (struct inotify_event *) (buf + pos);
+	  guint idx;
+
+	  /* Events that were lost may have been of any of the files */
+	  if (event->mask & IN_Q_OVERFLOW)
+	    {
+	      cb_poll (NULL);
+	      continue;
+	    }
+
+	  for (idx = 0; idx < files->len; idx++)
+	    {
+	      follow_file_t *file = g_ptr_array_index (files, idx);
+
+	      if (file->watch_descriptor == event->wd && event->len > 0
+		  && strcmp (event->name, file->basename) == 0
+		  && follow_file_read (file))
+		has_changed = TRUE;
+	    }
+	}
+    }
+  if (has_changed)
+    gxgraph_schedule_update ();
+
+  return TRUE;
+}
+
+/* Watch the directories of the files, so that the files that are
+   created or replaced are seen as well */
+static gboolean
+follow_inotify_start (void)
+{
+  guint idx;
+  int fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+  if (fd < 0)
+    return FALSE;
+
+  for (idx = 0; idx < files->len; idx++)
+    {
+      follow_file_t *file = g_ptr_array_index (files, idx);
+      gchar *dirname = g_path_get_dirname (file->filename);
+
+      file->watch_descriptor =
+	inotify_add_watch (fd, dirname,
+			   IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE
+			   | IN_MOVED_TO);
+      g_free (dirname);
+      if (file->watch_descriptor < 0)
+	{
+	  close (fd);
+	  return FALSE;
+	}
+    }
+
+  inotify_channel = g_io_channel_unix_new (fd);
+  g_io_channel_set_close_on_unref (inotify_channel, TRUE);
+  inotify_watch_id = g_io_add_watch (inotify_channel, G_IO_IN, cb_inotify,
+				     NULL);
+
+  return TRUE;
+}
+#endif
+
+/* Read the files and keep following them */
+void
+gxgraph_follow_start (int argc, char *argv[])
+{
+  int argp;
+
+  files = g_ptr_array_new ();
+  for (argp = 0; argp < argc; argp++)
+    {
+      follow_file_t *file = g_new0 (follow_file_t, 1);
+      gxgraph_arena_t *arena = gxgraph_arena_new ();
+
+      file->filename = g_strdup (argv[argp]);
+      file->basename = g_path_get_basename (argv[argp]);
+      file->loader = loader_new (file->filename, arena, LOADER_FOLLOW);
+      file->pending = g_string_new (NULL);
+      file->watch_descriptor = -1;
+      g_ptr_array_add (files, file);
+      gxgraph_arena_unref (arena);
+
+      if (!follow_file_read (file))
+	fprintf (stderr, "Warning! %s is empty or can't be opened, and "
+		 "will be read when it is written.\n", file->filename);
+    }
+
+#ifdef HAVE_INOTIFY
+  if (follow_inotify_start ())
+    return;
+#endif
+  poll_id = g_timeout_add (FOLLOW_POLL_INTERVAL, cb_poll, NULL);
+}
+
+void
+gxgraph_follow_stop (void)
+{
+  guint idx;
+
+#ifdef HAVE_INOTIFY
+  if (inotify_channel)
+    {
+      g_source_remove (inotify_watch_id);
+      g_io_channel_unref (inotify_channel);
+      inotify_channel = NULL;
+    }
+#endif
+  if (poll_id)
+    {
+      g_source_remove (poll_id);
+      poll_id = 0;
+    }
+
+  for (idx = 0; files && idx < files->len; idx++)
+    {
+      follow_file_t *file = g_ptr_array_index (files, idx);
+
+      loader_free (file->loader);
+      g_string_free (file->pending, TRUE);
+      g_free (file->filename);
+      g_free (file->basename);
+      g_free (file);
+    }
+  if (files)
+    g_ptr_array_free (files, TRUE);
+  files = NULL;
+}
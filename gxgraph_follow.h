@@ -0,0 +1,18 @@
+/*======================================================================
+//  gxgraph_follow.h - Follow data files that are still being written,
+//  and show what is appended to them while the windows are shown.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_FOLLOW_H
+#define GXGRAPH_FOLLOW_H
+
+#include <glib.h>
+
+void gxgraph_follow_start (int argc, char *argv[]);
+void gxgraph_follow_stop (void);
+
+#endif /* GXGRAPH_FOLLOW */
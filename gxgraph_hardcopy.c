@@ -7,20 +7,45 @@
 */
 #include <stdio.h>
 #include <gtk/gtk.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "gxgraph.h"
 #include "ps_painter.h"
 #include "svg_painter.h"
+#include "cairo_painter.h"
 
 typedef enum
 {
   OUTPUT_DEVICE_PRINT,
   OUTPUT_DEVICE_POSTSCRIPT,
-  OUTPUT_DEVICE_SVG
+  OUTPUT_DEVICE_SVG,
+  OUTPUT_DEVICE_PNG,
+  OUTPUT_DEVICE_PDF
 } output_device_t;
 
+/* An export running on a worker thread. The worker only sees a
+   snapshot of the window, so the windows stay usable meanwhile. */
+typedef struct
+{
+  GtkWidget *dialog;		/* NULL once the dialog is gone */
+  window_t *snapshot;
+  painter_t *painter;
+  output_device_t output_device;
+  gchar *filename;
+  gchar *tmp_filename;		/* NULL when printing */
+  GThread *thread;
+  int status;
+
+  /* Shared with the worker */
+  volatile gint is_cancelled;
+  volatile gint is_done;
+  volatile gint permille;
+} export_job_t;
+
 static void cb_response (GtkWidget * dialog,
 			 gint response, gpointer user_data);
+static void export_job_detach (export_job_t * job);
 static GtkWidget *make_menu_item (gchar * name,
 				  GtkWidget * menu, gpointer data);
 
@@ -29,13 +54,14 @@ static int cb_menu_item_assign_variable (GtkWidget * widget, int val);
 // Can make this static as there can only be one hardcopy dialog.
 static output_device_t output_device = 0;
 static char *output_device_name = NULL;
+static char lod_dpi_text[32] = "0";
 
 GtkWidget *
 gxgraph_hardcopy_dialog_new (GtkWidget * parent, window_t * window)
 {
   GtkWidget *dialog;
   GtkWidget *dialog_vbox;
-  GtkWidget *table, *button, *entry;
+  GtkWidget *table, *button, *entry, *progress_bar;
   int row;
 
   dialog = gtk_dialog_new_with_buttons ("Hardcopy",
@@ -51,11 +77,11 @@ gxgraph_hardcopy_dialog_new (GtkWidget * parent, window_t * window)
 
   /* Create an interface like in xgraph */
   /*
-     Output device: [PostScript] [SVG]
+     Output device: [PostScript] [SVG] [PNG] [PDF]
      Disposition:   [Print] [File]
      File or device name:
    */
-  table = gtk_table_new (2, 2, 0);
+  table = gtk_table_new (3, 2, 0);
   gtk_box_pack_start (GTK_BOX (dialog_vbox), table, FALSE, FALSE, 0);
   row = 0;
   gtk_table_attach (GTK_TABLE (table),
@@ -89,6 +115,18 @@ gxgraph_hardcopy_dialog_new (GtkWidget * parent, window_t * window)
       gtk_menu_item_select (GTK_MENU_ITEM (item));
     gtk_menu_append (GTK_MENU (menu), item);
 
+    item = make_menu_item ("Export PNG",
+			   menu, GINT_TO_POINTER (OUTPUT_DEVICE_PNG));
+    if (output_device == OUTPUT_DEVICE_PNG)
+      gtk_menu_item_select (GTK_MENU_ITEM (item));
+    gtk_menu_append (GTK_MENU (menu), item);
+
+    item = make_menu_item ("Export PDF",
+			   menu, GINT_TO_POINTER (OUTPUT_DEVICE_PDF));
+    if (output_device == OUTPUT_DEVICE_PDF)
+      gtk_menu_item_select (GTK_MENU_ITEM (item));
+    gtk_menu_append (GTK_MENU (menu), item);
+
     /* attach the menu to the button */
     gtk_option_menu_set_menu (GTK_OPTION_MENU (button), menu);
   }
@@ -111,9 +149,29 @@ gxgraph_hardcopy_dialog_new (GtkWidget * parent, window_t * window)
 		    (GtkAttachOptions) 0, 0, 0);
   g_object_set_data (G_OBJECT (dialog), "filename_entry", entry);
 
+  // Decimation resolution
+  row++;
+  gtk_table_attach (GTK_TABLE (table),
+		    gtk_label_new ("Decimate at dpi (0 is off):"),
+		    0, 1, row, row + 1,
+		    (GtkAttachOptions) 0, (GtkAttachOptions) 0, 3, 0);
+  entry = gtk_entry_new ();
+  gtk_entry_set_text (GTK_ENTRY (entry), lod_dpi_text);
+  gtk_table_attach (GTK_TABLE (table),
+		    entry,
+		    1, 2, row, row + 1,
+		    (GtkAttachOptions) (GTK_EXPAND | GTK_FILL),
+		    (GtkAttachOptions) 0, 0, 0);
+  g_object_set_data (G_OBJECT (dialog), "lod_entry", entry);
+
   /* Show it all */
   gtk_widget_show_all (dialog_vbox);
 
+  /* Only shown while exporting */
+  progress_bar = gtk_progress_bar_new ();
+  gtk_box_pack_start (GTK_BOX (dialog_vbox), progress_bar, FALSE, FALSE, 3);
+  g_object_set_data (G_OBJECT (dialog), "progress_bar", progress_bar);
+
   return dialog;
 }
 
@@ -123,61 +181,217 @@ gxgraph_hardcopy_destroy (GtkWidget * widget)
   gtk_widget_destroy (widget);
 }
 
+static gboolean
+cb_export_progress (painter_t * painter, double fraction)
+{
+  export_job_t *job = painter->progress_data;
+
+  g_atomic_int_set (&job->permille, (gint) (fraction * 1000));
+
+  return !g_atomic_int_get (&job->is_cancelled);
+}
+
+static gpointer
+export_thread (gpointer data)
+{
+  export_job_t *job = data;
+
+  gxgraph_draw_window (job->snapshot, job->painter);
+
+  switch (job->output_device)
+    {
+    case OUTPUT_DEVICE_PRINT:
+      ps_painter_delete (job->painter);
+      break;
+    case OUTPUT_DEVICE_SVG:
+      svg_painter_delete (job->painter);
+      break;
+    case OUTPUT_DEVICE_POSTSCRIPT:
+    case OUTPUT_DEVICE_PNG:
+    case OUTPUT_DEVICE_PDF:
+      job->status = cairo_painter_delete (job->painter);
+      break;
+    }
+  job->painter = NULL;
+
+  g_atomic_int_set (&job->is_done, TRUE);
+
+  return NULL;
+}
+
+static void
+cb_dialog_destroyed (GtkWidget * dialog, gpointer user_data)
+{
+  export_job_t *job = user_data;
+
+  g_atomic_int_set (&job->is_cancelled, TRUE);
+  job->dialog = NULL;
+}
+
+/* Let the export finish without the dialog */
+static void
+export_job_detach (export_job_t * job)
+{
+  if (!job->dialog)
+    return;
+
+  g_signal_handlers_disconnect_by_func (job->dialog,
+					G_CALLBACK (cb_dialog_destroyed), job);
+  g_object_set_data (G_OBJECT (job->dialog), "export_job", NULL);
+  job->dialog = NULL;
+}
+
+/* Called from the main loop to show the progress and to clean up
+   when the worker is done. */
+static gboolean
+cb_poll_export (gpointer user_data)
+{
+  export_job_t *job = user_data;
+
+  if (!g_atomic_int_get (&job->is_done))
+    {
+      if (job->dialog)
+	gtk_progress_bar_set_fraction
+	  (GTK_PROGRESS_BAR (g_object_get_data (G_OBJECT (job->dialog),
+						"progress_bar")),
+	   g_atomic_int_get (&job->permille) / 1000.0);
+      return TRUE;
+    }
+
+  g_thread_join (job->thread);
+
+  /* Only replace the target once it has been completely written */
+  if (job->tmp_filename)
+    {
+      if (g_atomic_int_get (&job->is_cancelled) || job->status != 0)
+	g_unlink (job->tmp_filename);
+      else if (g_rename (job->tmp_filename, job->filename) != 0)
+	fprintf (stderr, "Failed renaming %s to %s!\n",
+		 job->tmp_filename, job->filename);
+    }
+
+  if (job->dialog)
+    {
+      GtkWidget *dialog = job->dialog;
+
+      export_job_detach (job);
+      gxgraph_hardcopy_destroy (dialog);
+    }
+
+  gxgraph_window_snapshot_free (job->snapshot);
+  g_free (job->filename);
+  g_free (job->tmp_filename);
+  g_free (job);
+
+  return FALSE;
+}
+
 static void
 cb_response (GtkWidget * dialog, gint response, gpointer user_data)
 {
   window_t *window = user_data;
-  gchar *psdevice_name = NULL;
+  export_job_t *job = g_object_get_data (G_OBJECT (dialog), "export_job");
+
+  if (job)
+    {
+      /* Anything but OK while exporting cancels the export */
+      if (response == GTK_RESPONSE_OK)
+	return;
+      g_atomic_int_set (&job->is_cancelled, TRUE);
+      export_job_detach (job);
+      gxgraph_hardcopy_destroy (dialog);
+      return;
+    }
 
   if (response == GTK_RESPONSE_OK)
     {
       const gchar *filename =
 	gtk_entry_get_text (GTK_ENTRY (g_object_get_data (G_OBJECT (dialog),
 							  "filename_entry")));
-      painter_t *painter;
+      const gchar *lod_text =
+	gtk_entry_get_text (GTK_ENTRY (g_object_get_data (G_OBJECT (dialog),
+							  "lod_entry")));
+      painter_t *painter = NULL;
 
       if (output_device_name)
 	g_free (output_device_name);
       output_device_name = g_strdup (filename);
 
-      switch (output_device)
+      job = g_new0 (export_job_t, 1);
+      job->output_device = output_device;
+      if (output_device == OUTPUT_DEVICE_PRINT)
 	{
-	case OUTPUT_DEVICE_PRINT:
 	  if (strlen (filename))
-	    psdevice_name = g_strdup_printf ("|lp -d'%s'", filename);
+	    job->filename = g_strdup_printf ("|lp -d'%s'", filename);
 	  else
-	    psdevice_name = g_strdup ("|lp");
-	  filename = psdevice_name;
-	  painter = ps_painter_new (window, filename);
-	  break;
-	case OUTPUT_DEVICE_POSTSCRIPT:
-	  painter = ps_painter_new (window, filename);
-	  break;
-	case OUTPUT_DEVICE_SVG:
-	  painter = svg_painter_new (window, filename);
-	  break;
+	    job->filename = g_strdup ("|lp");
+	  filename = job->filename;
+	}
+      else
+	{
+	  job->filename = g_strdup (filename);
+	  job->tmp_filename = g_strdup_printf ("%s.tmp", filename);
+	  filename = job->tmp_filename;
 	}
-
-      gxgraph_draw_window (window, painter);
 
       switch (output_device)
 	{
 	case OUTPUT_DEVICE_PRINT:
-	  g_free (psdevice_name);
-	  ps_painter_delete (painter);
+	  painter = ps_painter_new (window, filename);
 	  break;
 	case OUTPUT_DEVICE_POSTSCRIPT:
-	  ps_painter_delete (painter);
+	  painter = cairo_painter_new_for_file (window, filename,
+						CAIRO_PAINTER_FORMAT_PS);
 	  break;
 	case OUTPUT_DEVICE_SVG:
-	  svg_painter_delete (painter);
+	  painter = svg_painter_new (window, filename);
+	  break;
+	case OUTPUT_DEVICE_PNG:
+	  painter = cairo_painter_new_for_file (window, filename,
+						CAIRO_PAINTER_FORMAT_PNG);
+	  break;
+	case OUTPUT_DEVICE_PDF:
+	  painter = cairo_painter_new_for_file (window, filename,
+						CAIRO_PAINTER_FORMAT_PDF);
 	  break;
 	}
-    }
 
-  if (response != GTK_RESPONSE_APPLY)
-    {
+      if (!painter)
+	{
+	  fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+	  g_free (job->filename);
+	  g_free (job->tmp_filename);
+	  g_free (job);
+	  gxgraph_hardcopy_destroy (dialog);
+	  return;
+	}
+
+      g_strlcpy (lod_dpi_text, lod_text, sizeof (lod_dpi_text));
+      painter->lod_dpi = atof (lod_dpi_text);
+      painter->progress = cb_export_progress;
+      painter->progress_data = job;
+
+      job->painter = painter;
+      job->snapshot = gxgraph_window_snapshot (window);
+      job->dialog = dialog;
+      g_object_set_data (G_OBJECT (dialog), "export_job", job);
+      g_signal_connect (dialog, "destroy",
+			G_CALLBACK (cb_dialog_destroyed), job);
+
+      gtk_dialog_set_response_sensitive (GTK_DIALOG (dialog),
+					 GTK_RESPONSE_OK, FALSE);
+      gtk_widget_show (g_object_get_data (G_OBJECT (dialog),
+					  "progress_bar"));
+
+#if GLIB_CHECK_VERSION(2,32,0)
+      job->thread = g_thread_new ("export", export_thread, job);
+#else
+      job->thread = g_thread_create (export_thread, job, TRUE, NULL);
+#endif
+      g_timeout_add (100, cb_poll_export, job);
+      return;
     }
+
   gxgraph_hardcopy_destroy (dialog);
 }
 
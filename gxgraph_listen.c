@@ -0,0 +1,367 @@
+/*======================================================================
+//  gxgraph_listen.c - Receive data from other processes through a
+//  Unix domain socket or a FIFO while the windows are shown.
+//
+//  Each producer writes the same text format as the data files. The
+//  points may also be sent in binary frames of:
+//
+//      "\0GXB"                          magic
+//      guint32 num_points
+//      guint32 name_len
+//      char name[name_len]              set name, empty for the current
+//      double xy[2 * num_points]        x0 y0 x1 y1 ...
+//
+//  with the integers and doubles in the byte order of the host.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "gxgraph.h"
+#include "gxgraph_arena.h"
+#include "gxgraph_listen.h"
+
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define LISTEN_READ_SIZE 65536
+
+/* Longest text line, as for the data files */
+#define LISTEN_MAX_LINE 256
+
+/* Frames beyond these sizes mean that the stream is broken */
+#define LISTEN_MAX_NAME_LEN 255
+#define LISTEN_MAX_FRAME_POINTS (1 << 24)
+#define LISTEN_FRAME_HEADER_LEN \
+  (LISTEN_FRAME_MAGIC_LEN + 2 * sizeof (guint32))
+
+/* A producer connected to the socket, or the FIFO */
+typedef struct
+{
+  GIOChannel *channel;
+  guint watch_id;
+  loader_t *loader;
+  GString *pending;		/* Bytes that don't make a line or a
+				   frame yet                             */
+} listen_client_t;
+
+static gchar *listen_path = NULL;
+static GIOChannel *listen_channel = NULL;	/* The socket, if not a FIFO */
+static guint listen_watch_id = 0;
+static int fifo_writer_fd = -1;
+static GSList *clients = NULL;
+
+static void
+client_free (listen_client_t * client)
+{
+  /* A last line without a newline */
+  if (client->pending->len > 0 && client->pending->str[0] != '\0')
+    {
+      g_string_truncate (client->pending,
+			 MIN (client->pending->len, LISTEN_MAX_LINE - 1));
+      loader_parse_line (client->loader, client->pending->str);
+    }
+
+  if (client->watch_id)
+    g_source_remove (client->watch_id);
+  g_io_channel_unref (client->channel);
+  loader_free (client->loader);
+  g_string_free (client->pending, TRUE);
+  clients = g_slist_remove (clients, client);
+  g_free (client);
+}
+
+#ifdef G_OS_UNIX
+/* Parse the lines and frames that have been received in full. Returns
+   FALSE if the stream is broken. */
+static gboolean
+client_parse (listen_client_t * client)
+{
+  const gchar *data = client->pending->str;
+  gsize len = client->pending->len;
+  gsize pos = 0;
+  gboolean is_ok = TRUE;
+
+  while (pos < len)
+    {
+      if (data[pos] == '\0')
+	{
+	  guint32 num_points, name_len;
+	  gsize frame_len;
+	  gchar *name = NULL;
+	  double *xy;
+
+	  if (len - pos < LISTEN_FRAME_HEADER_LEN)
+	    break;
+	  memcpy (&num_points, data + pos + LISTEN_FRAME_MAGIC_LEN,
+		  sizeof (guint32));
+	  memcpy (&name_len,
+		  data + pos + LISTEN_FRAME_MAGIC_LEN + sizeof (guint32),
+		  sizeof (guint32));
+	  if (memcmp (data + pos, LISTEN_FRAME_MAGIC,
+		      LISTEN_FRAME_MAGIC_LEN) != 0
+	      || num_points > LISTEN_MAX_FRAME_POINTS
+	      || name_len > LISTEN_MAX_NAME_LEN)
+	    {
+	      is_ok = FALSE;
+	      break;
+	    }
+	  frame_len = LISTEN_FRAME_HEADER_LEN + name_len
+	    + 2 * sizeof (double) * num_points;
+	  if (len - pos < frame_len)
+	    break;
+
+	  if (name_len > 0)
+	    name = g_strndup (data + pos + LISTEN_FRAME_HEADER_LEN, name_len);
+
+	  /* The doubles aren't aligned in the buffer */
+	  xy = g_new (double, 2 * num_points);
+	  memcpy (xy, data + pos + LISTEN_FRAME_HEADER_LEN + name_len,
+		  2 * sizeof (double) * num_points);
+	  loader_append_points (client->loader, name, xy, num_points);
+
+	  g_free (xy);
+	  g_free (name);
+	  pos += frame_len;
+	}
+      else
+	{
+	  char S_[LISTEN_MAX_LINE];
+	  const gchar *newline = memchr (data + pos, '\n',
+					 MIN (len - pos, sizeof (S_) - 1));
+	  gsize line_len;
+
+	  /* Long lines are split like fgets() does */
+	  if (newline)
+	    line_len = newline - (data + pos) + 1;
+	  else if (len - pos >= sizeof (S_) - 1)
+	    line_len = sizeof (S_) - 1;
+	  else
+	    break;
+
+	  memcpy (S_, data + pos, line_len);
+	  S_[line_len] = '\0';
+	  loader_parse_line (client->loader, S_);
+	  pos += line_len;
+	}
+    }
+
+  g_string_erase (client->pending, 0, pos);
+
+  return is_ok;
+}
+
+static gboolean
+cb_client_input (GIOChannel * channel, GIOCondition condition,
+		 gpointer user_data)
+{
+  listen_client_t *client = user_data;
+  gchar buf[LISTEN_READ_SIZE];
+  gsize num_read = 0;
+  GIOStatus status;
+
+  status = g_io_channel_read_chars (channel, buf, sizeof (buf), &num_read,
+				    NULL);
+  if (num_read > 0)
+    {
+      g_string_append_len (client->pending, buf, num_read);
+      if (!client_parse (client))
+	{
+	  fprintf (stderr, "Warning! Dropping a broken stream from %s!\n",
+		   listen_path);
+	  g_string_truncate (client->pending, 0);
+	  status = G_IO_STATUS_ERROR;
+	}
+      gxgraph_schedule_update ();
+    }
+
+  if (status == G_IO_STATUS_EOF || status == G_IO_STATUS_ERROR)
+    {
+      client->watch_id = 0;
+      client_free (client);
+      gxgraph_schedule_update ();
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+client_new (int fd)
+{
+  listen_client_t *client = g_new0 (listen_client_t, 1);
+  gxgraph_arena_t *arena = gxgraph_arena_new ();
+
+  client->channel = g_io_channel_unix_new (fd);
+  g_io_channel_set_encoding (client->channel, NULL, NULL);
+  g_io_channel_set_buffered (client->channel, FALSE);
+  g_io_channel_set_flags (client->channel, G_IO_FLAG_NONBLOCK, NULL);
+  g_io_channel_set_close_on_unref (client->channel, TRUE);
+  client->loader = loader_new (listen_path, arena, LOADER_LIVE);
+  client->pending = g_string_new (NULL);
+  client->watch_id = g_io_add_watch (client->channel,
+				     G_IO_IN | G_IO_HUP | G_IO_ERR,
+				     cb_client_input, client);
+  clients = g_slist_prepend (clients, client);
+  gxgraph_arena_unref (arena);
+}
+
+static gboolean
+cb_accept (GIOChannel * channel, GIOCondition condition, gpointer user_data)
+{
+  int fd = accept (g_io_channel_unix_get_fd (channel), NULL, NULL);
+
+  if (fd < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+	fprintf (stderr, "Warning! Couldn't accept a connection on %s: %s\n",
+		 listen_path, g_strerror (errno));
+      return TRUE;
+    }
+
+  client_new (fd);
+
+  return TRUE;
+}
+
+/* Create a non-blocking Unix domain socket at path that listens for
+   connections. Returns the descriptor, or -1 after a warning. */
+int
+gxgraph_listen_socket_open (const char *path)
+{
+  struct sockaddr_un addr;
+  struct stat st;
+  int fd;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "Warning! The socket path %s is too long!\n", path);
+      return -1;
+    }
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  /* Only a socket left behind by an earlier run, which nobody listens
+     on any more, is replaced */
+  if (stat (path, &st) == 0 && S_ISSOCK (st.st_mode))
+    {
+      int connect_errno = 0;
+
+      fd = socket (AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0
+	  || connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+	connect_errno = errno;
+      if (fd >= 0)
+	close (fd);
+      if (connect_errno == 0)
+	{
+	  fprintf (stderr, "Warning! Another process is listening on %s!\n",
+		   path);
+	  return -1;
+	}
+      if (connect_errno != ECONNREFUSED)
+	{
+	  fprintf (stderr, "Warning! Couldn't check the socket %s: %s\n",
+		   path, g_strerror (connect_errno));
+	  return -1;
+	}
+      unlink (path);
+    }
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || bind (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0
+      || listen (fd, SOMAXCONN) != 0)
+    {
+      fprintf (stderr, "Warning! Couldn't listen on %s: %s\n", path,
+	       g_strerror (errno));
+      if (fd >= 0)
+	close (fd);
+      return -1;
+    }
+  fcntl (fd, F_SETFL, O_NONBLOCK);
+
+  return fd;
+}
+#endif
+
+/* Listen for producers on the socket at path, which is created, or
+   read from the FIFO at path if there is one. */
+gboolean
+gxgraph_listen_start (const char *path)
+{
+#ifdef G_OS_UNIX
+  struct stat st;
+  int fd;
+
+  listen_path = g_strdup (path);
+
+  if (stat (path, &st) == 0 && S_ISFIFO (st.st_mode))
+    {
+      /* A writer of our own keeps the FIFO from hanging up when the
+         producers close it */
+      fd = open (path, O_RDONLY | O_NONBLOCK);
+      if (fd >= 0)
+	fifo_writer_fd = open (path, O_WRONLY | O_NONBLOCK);
+      if (fd < 0 || fifo_writer_fd < 0)
+	{
+	  fprintf (stderr, "Warning! Couldn't open %s: %s\n", path,
+		   g_strerror (errno));
+	  if (fd >= 0)
+	    close (fd);
+	  return FALSE;
+	}
+      client_new (fd);
+      return TRUE;
+    }
+
+  fd = gxgraph_listen_socket_open (path);
+  if (fd < 0)
+    return FALSE;
+
+  listen_channel = g_io_channel_unix_new (fd);
+  g_io_channel_set_close_on_unref (listen_channel, TRUE);
+  listen_watch_id = g_io_add_watch (listen_channel, G_IO_IN, cb_accept,
+				    NULL);
+
+  return TRUE;
+#else
+  fprintf (stderr, "Warning! Listening for data needs Unix sockets.\n");
+  return FALSE;
+#endif
+}
+
+void
+gxgraph_listen_stop (void)
+{
+  while (clients)
+    client_free (clients->data);
+
+#ifdef G_OS_UNIX
+  if (listen_channel)
+    {
+      g_source_remove (listen_watch_id);
+      g_io_channel_unref (listen_channel);
+      listen_channel = NULL;
+      unlink (listen_path);
+    }
+  if (fifo_writer_fd >= 0)
+    {
+      close (fifo_writer_fd);
+      fifo_writer_fd = -1;
+    }
+#endif
+  g_free (listen_path);
+  listen_path = NULL;
+}
@@ -0,0 +1,24 @@
+/*======================================================================
+//  gxgraph_listen.h - Receive data from other processes through a
+//  Unix domain socket or a FIFO while the windows are shown.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_LISTEN_H
+#define GXGRAPH_LISTEN_H
+
+#include <glib.h>
+
+/* The first bytes of a binary frame. Text lines never start with a
+   NUL, so frames and lines may be mixed in a stream. */
+#define LISTEN_FRAME_MAGIC "\0GXB"
+#define LISTEN_FRAME_MAGIC_LEN 4
+
+gboolean gxgraph_listen_start (const char *path);
+void gxgraph_listen_stop (void);
+int gxgraph_listen_socket_open (const char *path);
+
+#endif /* GXGRAPH_LISTEN */
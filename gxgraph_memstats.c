@@ -0,0 +1,249 @@
+/*======================================================================
+//  gxgraph_memstats.c - Accounting of the memory held by datasets
+//  and windows.
+//
+//  The sizes are computed from what gxgraph allocated and do not
+//  include the malloc overhead. The heap and resident set sizes as
+//  seen by the system are printed next to them for comparison.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include "gxgraph.h"
+#include "gxgraph_memstats.h"
+#include "gtk_painter.h"
+#include "parser.h"
+#include "gxgraph_arena.h"
+#include "gxgraph_spill.h"
+#include "gxgraph_pyramid.h"
+
+#ifdef G_OS_UNIX
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+typedef struct
+{
+  glong heap_bytes;
+  glong num_allocs;
+  glong alloc_bytes;
+  double seconds;
+} load_stats_t;
+
+static load_stats_t load_stats;
+static GTimer *load_timer = NULL;
+static gboolean has_load_stats = FALSE;
+
+/* Bytes in use on the heap, or -1 if it can't be found */
+static glong
+heap_bytes_in_use (void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2,33)
+  struct mallinfo2 mi = mallinfo2 ();
+
+  return mi.uordblks + mi.hblkhd;
+#elif defined(__GLIBC__)
+  struct mallinfo mi = mallinfo ();
+
+  return (unsigned int) mi.uordblks + (unsigned int) mi.hblkhd;
+#else
+  return -1;
+#endif
+}
+
+/* Peak resident set size in bytes, or -1 if it can't be found */
+static glong
+peak_rss_bytes (void)
+{
+#ifdef G_OS_UNIX
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024L;
+#endif
+#else
+  return -1;
+#endif
+}
+
+void
+gxgraph_memstats_load_begin (void)
+{
+  if (!load_timer)
+    load_timer = g_timer_new ();
+  g_timer_start (load_timer);
+
+  parser_get_alloc_counts (&load_stats.num_allocs, &load_stats.alloc_bytes);
+  load_stats.heap_bytes = heap_bytes_in_use ();
+}
+
+void
+gxgraph_memstats_load_end (void)
+{
+  glong num_allocs, alloc_bytes, heap_bytes;
+
+  load_stats.seconds = g_timer_elapsed (load_timer, NULL);
+  parser_get_alloc_counts (&num_allocs, &alloc_bytes);
+  heap_bytes = heap_bytes_in_use ();
+
+  load_stats.num_allocs = num_allocs - load_stats.num_allocs;
+  load_stats.alloc_bytes = alloc_bytes - load_stats.alloc_bytes;
+  if (heap_bytes >= 0 && load_stats.heap_bytes >= 0)
+    load_stats.heap_bytes = heap_bytes - load_stats.heap_bytes;
+  else
+    load_stats.heap_bytes = -1;
+  has_load_stats = TRUE;
+}
+
+/* The size that a GArray grown by appending has allocated for len
+   elements. GArray rounds up to the nearest power of two. */
+static glong
+garray_alloc_bytes (guint len, int element_size)
+{
+  glong want = (glong) len * element_size;
+  glong alloc = 16;
+
+  if (len == 0)
+    return 0;
+  while (alloc < want)
+    alloc <<= 1;
+
+  return alloc;
+}
+
+static glong
+string_bytes (const char *string)
+{
+  return string ? strlen (string) + 1 : 0;
+}
+
+static void
+print_bytes (FILE * OUT, const char *label, glong bytes)
+{
+  if (bytes < 0)
+    fprintf (OUT, "  %-22s %12s\n", label, "n/a");
+  else
+    fprintf (OUT, "  %-22s %12ld  (%.1f MB)\n", label, bytes,
+	     bytes / (1024.0 * 1024.0));
+}
+
+void
+gxgraph_memstats_print (FILE * OUT, GPtrArray * datasets, window_t * windows)
+{
+  dataset_t *ds_p;
+  guint ds_idx;
+  window_t *window;
+  gxgraph_arena_t *arena = NULL;
+  glong arena_bytes = 0;
+  glong spill_bytes = 0;
+  glong total = 0;
+  int w_idx = 0;
+
+  fprintf (OUT, "Datasets:\n");
+  fprintf (OUT, "  %-4s %10s %12s %12s %12s %10s %12s\n",
+	   "set", "points", "point bytes", "slack", "text marks",
+	   "strings", "total");
+  for (ds_idx = 0; datasets && ds_idx < datasets->len; ds_idx++)
+    {
+      glong num_points, point_bytes;
+      guint point_size;
+      glong slack = 0;
+      glong text_bytes = 0;
+      glong strings;
+      glong ds_total;
+      const char *name;
+      int p_idx;
+
+      ds_p = g_ptr_array_index (datasets, ds_idx);
+      if (!ds_p)
+	continue;
+      num_points = dataset_get_num_points (ds_p);
+      point_size = ds_p->points ? g_array_get_element_size (ds_p->points) : 0;
+      point_bytes = ds_p->points ? num_points * point_size : 0;
+
+      if (ds_p->points)
+	{
+	  /* Rings are allocated in full, and the boxes of their blocks
+	     are counted with the slots that aren't filled yet */
+	  slack = garray_alloc_bytes (MAX (ds_p->points->len,
+					   ds_p->ring_capacity), point_size)
+	    - point_bytes;
+	  if (ds_p->pyramid)
+	    slack += gxgraph_pyramid_get_size (ds_p->pyramid);
+	  for (p_idx = 0; p_idx < ds_p->points->len; p_idx++)
+	    {
+	      point_t p = dataset_get_point (ds_p, p_idx);
+
+	      if (p.op == OP_TEXT)
+		text_bytes += sizeof (text_mark_t)
+		  + string_bytes (p.data.text_object->string);
+	    }
+	}
+      if (ds_p->text_marks)
+	text_bytes += ds_p->text_marks->len * sizeof (gpointer);
+      if (ds_p->spill)
+	spill_bytes += gxgraph_spill_get_size (ds_p->spill);
+      strings = string_bytes (ds_p->set_name)
+	+ string_bytes (ds_p->path_name)
+	+ string_bytes (ds_p->file_name)
+	+ string_bytes (ds_p->tree_path_string);
+
+      ds_total = sizeof (dataset_t) + sizeof (GArray) + point_bytes + slack
+	+ text_bytes + strings;
+      name = ds_p->set_name ? ds_p->set_name : "";
+      fprintf (OUT, "  %-4u %10ld %12ld %12ld %12ld %10ld %12ld  %.*s\n",
+	       ds_p->id, num_points, point_bytes, slack, text_bytes, strings,
+	       ds_total, (int) strcspn (name, "\r\n"), name);
+      total += ds_total;
+
+      /* The datasets of a load are next to each other */
+      if (ds_p->arena != arena)
+	{
+	  arena = ds_p->arena;
+	  arena_bytes += gxgraph_arena_get_size (arena);
+	}
+    }
+
+  fprintf (OUT, "Windows:\n");
+  for (window = windows; window; window = window->next_window)
+    {
+      glong window_bytes = sizeof (window_t)
+	+ window->datasets->len * sizeof (gpointer);
+      glong painter_bytes = 0;
+
+      if (window->gtk_painter)
+	painter_bytes = gtk_painter_get_memory_size (window->gtk_painter);
+
+      fprintf (OUT, "  %-4d %4.0fx%-6.0f window %ld, pixmaps and caches %ld\n",
+	       w_idx++, window->width, window->height,
+	       window_bytes, painter_bytes);
+      total += window_bytes + painter_bytes;
+    }
+
+  fprintf (OUT, "Totals:\n");
+  print_bytes (OUT, "datasets and windows", total);
+  print_bytes (OUT, "string arenas", arena_bytes);
+  if (spill_bytes > 0)
+    print_bytes (OUT, "spill files (mapped)", spill_bytes);
+  print_bytes (OUT, "heap in use", heap_bytes_in_use ());
+  print_bytes (OUT, "peak resident", peak_rss_bytes ());
+
+  if (has_load_stats)
+    {
+      fprintf (OUT, "Load phase (%.3f s):\n", load_stats.seconds);
+      print_bytes (OUT, "heap growth", load_stats.heap_bytes);
+      fprintf (OUT, "  %-22s %12ld\n", "parser allocations",
+	       load_stats.num_allocs);
+      print_bytes (OUT, "parser bytes", load_stats.alloc_bytes);
+    }
+}
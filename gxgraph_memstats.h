@@ -0,0 +1,21 @@
+/*======================================================================
+//  gxgraph_memstats.h - Accounting of the memory held by datasets
+//  and windows.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_MEMSTATS_H
+#define GXGRAPH_MEMSTATS_H
+
+#include <stdio.h>
+#include "gxgraph.h"
+
+void gxgraph_memstats_load_begin (void);
+void gxgraph_memstats_load_end (void);
+void gxgraph_memstats_print (FILE * OUT, GPtrArray * datasets,
+			     window_t * windows);
+
+#endif /* GXGRAPH_MEMSTATS */
@@ -0,0 +1,156 @@
+/*======================================================================
+//  gxgraph_pyramid.c - Bounding boxes of the blocks of a ring buffer
+//  dataset, and of ever larger groups of blocks up to the whole ring.
+//
+//  The boxes are kept in a binary tree stored in an array, with the
+//  whole ring at the root and the blocks at the leaves. Overwriting a
+//  slot only marks its block, and the marked blocks and the boxes
+//  above them are computed again when the boxes are next needed. The
+//  cost of an append is thus constant however large the ring is.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <math.h>
+#include "gxgraph_pyramid.h"
+
+struct gxgraph_pyramid_t_struct
+{
+  guint num_slots;
+  guint num_blocks;
+  guint num_leaves;		/* num_blocks rounded up to a power of two */
+
+  /* boxes[1] is the root and the children of box n are 2n and 2n+1.
+     Block b is at num_leaves + b. */
+  pyramid_box_t *boxes;
+  guint8 *is_dirty;		/* For each block                        */
+  GArray *dirty_blocks;
+};
+
+static const pyramid_box_t empty_box = { HUGE_VAL, HUGE_VAL,
+  -HUGE_VAL, -HUGE_VAL
+};
+
+gxgraph_pyramid_t *
+gxgraph_pyramid_new (guint num_slots)
+{
+  gxgraph_pyramid_t *pyramid = g_new0 (gxgraph_pyramid_t, 1);
+  guint idx;
+
+  pyramid->num_slots = num_slots;
+  pyramid->num_blocks = (num_slots + PYRAMID_BLOCK_SIZE - 1)
+    >> PYRAMID_BLOCK_SHIFT;
+  pyramid->num_leaves = 1;
+  while (pyramid->num_leaves < pyramid->num_blocks)
+    pyramid->num_leaves <<= 1;
+
+  pyramid->boxes = g_new (pyramid_box_t, 2 * pyramid->num_leaves);
+  for (idx = 0; idx < 2 * pyramid->num_leaves; idx++)
+    pyramid->boxes[idx] = empty_box;
+  pyramid->is_dirty = g_new0 (guint8, pyramid->num_blocks);
+  pyramid->dirty_blocks = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  return pyramid;
+}
+
+void
+gxgraph_pyramid_free (gxgraph_pyramid_t * pyramid)
+{
+  g_free (pyramid->boxes);
+  g_free (pyramid->is_dirty);
+  g_array_free (pyramid->dirty_blocks, TRUE);
+  g_free (pyramid);
+}
+
+/* The point in a slot has changed */
+void
+gxgraph_pyramid_invalidate (gxgraph_pyramid_t * pyramid, guint slot)
+{
+  guint block_idx = slot >> PYRAMID_BLOCK_SHIFT;
+
+  if (pyramid->is_dirty[block_idx])
+    return;
+
+  pyramid->is_dirty[block_idx] = TRUE;
+  g_array_append_val (pyramid->dirty_blocks, block_idx);
+}
+
+/* Compute the boxes of the blocks that have changed, and of the
+   groups that they are in */
+void
+gxgraph_pyramid_update (gxgraph_pyramid_t * pyramid,
+			pyramid_block_func_t block_box, gpointer user_data)
+{
+  guint idx;
+
+  /* Windows drawn by several threads only read the boxes */
+  if (pyramid->dirty_blocks->len == 0)
+    return;
+
+  for (idx = 0; idx < pyramid->dirty_blocks->len; idx++)
+    {
+      guint block_idx = g_array_index (pyramid->dirty_blocks, guint, idx);
+      guint first = block_idx << PYRAMID_BLOCK_SHIFT;
+      pyramid_box_t *box = &pyramid->boxes[pyramid->num_leaves + block_idx];
+      guint node;
+
+      *box = empty_box;
+      block_box (user_data, first,
+		 MIN (first + PYRAMID_BLOCK_SIZE, pyramid->num_slots), box);
+      pyramid->is_dirty[block_idx] = FALSE;
+
+      for (node = (pyramid->num_leaves + block_idx) / 2; node >= 1;
+	   node /= 2)
+	{
+	  pyramid_box_t *left = &pyramid->boxes[2 * node];
+	  pyramid_box_t *right = &pyramid->boxes[2 * node + 1];
+
+	  pyramid->boxes[node].x0 = MIN (left->x0, right->x0);
+	  pyramid->boxes[node].y0 = MIN (left->y0, right->y0);
+	  pyramid->boxes[node].x1 = MAX (left->x1, right->x1);
+	  pyramid->boxes[node].y1 = MAX (left->y1, right->y1);
+	}
+    }
+
+  g_array_set_size (pyramid->dirty_blocks, 0);
+}
+
+guint
+gxgraph_pyramid_get_num_blocks (gxgraph_pyramid_t * pyramid)
+{
+  return pyramid->num_blocks;
+}
+
+const pyramid_box_t *
+gxgraph_pyramid_get_block (gxgraph_pyramid_t * pyramid, guint block_idx)
+{
+  return &pyramid->boxes[pyramid->num_leaves + block_idx];
+}
+
+/* The box of all the slots */
+const pyramid_box_t *
+gxgraph_pyramid_get_root (gxgraph_pyramid_t * pyramid)
+{
+  return &pyramid->boxes[1];
+}
+
+gboolean
+gxgraph_pyramid_block_intersects (gxgraph_pyramid_t * pyramid,
+				  guint block_idx, double x0, double y0,
+				  double x1, double y1)
+{
+  const pyramid_box_t *box = gxgraph_pyramid_get_block (pyramid, block_idx);
+
+  return box->x1 >= x0 && box->x0 <= x1 && box->y1 >= y0 && box->y0 <= y1;
+}
+
+gsize
+gxgraph_pyramid_get_size (gxgraph_pyramid_t * pyramid)
+{
+  return sizeof (gxgraph_pyramid_t)
+    + 2 * pyramid->num_leaves * sizeof (pyramid_box_t)
+    + pyramid->num_blocks
+    + pyramid->dirty_blocks->len * sizeof (guint);
+}
@@ -0,0 +1,45 @@
+/*======================================================================
+//  gxgraph_pyramid.h - Bounding boxes of the blocks of a ring buffer
+//  dataset, and of ever larger groups of blocks up to the whole ring.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_PYRAMID_H
+#define GXGRAPH_PYRAMID_H
+
+#include <glib.h>
+
+/* Number of slots in a block with its own bounding box */
+#define PYRAMID_BLOCK_SHIFT 6
+#define PYRAMID_BLOCK_SIZE (1 << PYRAMID_BLOCK_SHIFT)
+
+typedef struct
+{
+  double x0, y0, x1, y1;
+} pyramid_box_t;
+
+/* Finds the bounding box of the slots [first_slot, end_slot) */
+typedef void (*pyramid_block_func_t) (gpointer user_data, guint first_slot,
+				      guint end_slot, pyramid_box_t * box);
+
+typedef struct gxgraph_pyramid_t_struct gxgraph_pyramid_t;
+
+gxgraph_pyramid_t *gxgraph_pyramid_new (guint num_slots);
+void gxgraph_pyramid_free (gxgraph_pyramid_t * pyramid);
+void gxgraph_pyramid_invalidate (gxgraph_pyramid_t * pyramid, guint slot);
+void gxgraph_pyramid_update (gxgraph_pyramid_t * pyramid,
+			     pyramid_block_func_t block_box,
+			     gpointer user_data);
+guint gxgraph_pyramid_get_num_blocks (gxgraph_pyramid_t * pyramid);
+const pyramid_box_t *gxgraph_pyramid_get_block (gxgraph_pyramid_t * pyramid,
+						guint block_idx);
+const pyramid_box_t *gxgraph_pyramid_get_root (gxgraph_pyramid_t * pyramid);
+gboolean gxgraph_pyramid_block_intersects (gxgraph_pyramid_t * pyramid,
+					   guint block_idx, double x0,
+					   double y0, double x1, double y1);
+gsize gxgraph_pyramid_get_size (gxgraph_pyramid_t * pyramid);
+
+#endif /* GXGRAPH_PYRAMID */
@@ -0,0 +1,714 @@
+/*======================================================================
+//  gxgraph_server.c - Keep one gxgraph running that plots the data
+//  sent to it by short lived clients.
+//
+//  This saves each plot the start up of gtk and of the fonts, and the
+//  parsing of data files that haven't changed since they were last
+//  plotted. A client connects to the Unix domain socket of the server
+//  and sends:
+//
+//      cwd\n                            the directory of the client
+//      arg\n ...                        its command line, one per line
+//      \n
+//      data                             its standard input, if no
+//                                       data files were given
+//
+//  and shuts down its side of the connection. The server then reads
+//  the files, plots them in a new window or to the file given with -o,
+//  and replies with its warnings followed by a line of OK or FAILED.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "gxgraph.h"
+#include "gxgraph_arena.h"
+#include "gxgraph_export.h"
+#include "gxgraph_listen.h"
+#include "gxgraph_server.h"
+
+#ifdef G_OS_UNIX
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#define SERVER_READ_SIZE 65536
+
+/* Longest line of the data, as for the data files */
+#define SERVER_MAX_LINE 256
+
+/* Largest request, with the data that is sent inline */
+#define SERVER_MAX_REQUEST (256 << 20)
+
+/* Files kept parsed after the plots that used them */
+#define SERVER_MAX_CACHED_FILES 64
+
+#ifdef G_OS_UNIX
+/* The plot settings that the directives of a data file change. The
+   texts that it doesn't set are NULL. */
+typedef struct
+{
+  gchar *title_text;
+  gchar *x_unit_text;
+  gchar *y_unit_text;
+  gboolean do_draw_marks;	/* LargePixels was given               */
+} server_settings_t;
+
+/* A data file as it was last read */
+typedef struct
+{
+  gchar *name;			/* As given, which names its sets       */
+  time_t mtime;
+  off_t size;
+  ino_t ino;
+  int first_set_idx;		/* Picked the colors of the sets        */
+  int num_sets;
+  guint last_use;		/* The request that last plotted it     */
+  GPtrArray *datasets;
+  server_settings_t settings;
+} server_file_t;
+
+/* A client whose request is being received */
+typedef struct
+{
+  GIOChannel *channel;
+  guint watch_id;
+  GString *request;
+} server_client_t;
+
+static gchar *server_path = NULL;
+static gboolean server_has_display = FALSE;
+static GIOChannel *server_channel = NULL;
+static GHashTable *file_cache = NULL;	/* Absolute path to server_file_t */
+static GPtrArray *retired_datasets = NULL;	/* Deleted when no window
+						   shows them any more   */
+static guint num_requests = 0;
+static server_settings_t startup_settings;	/* Of the command line */
+
+static void
+settings_replace_text (gchar ** text, const gchar * value)
+{
+  if (!value)
+    return;
+  g_free (*text);
+  *text = g_strdup (value);
+}
+
+/* Apply the settings of a data file on top of the current ones */
+static void
+server_settings_apply (const server_settings_t * settings)
+{
+  settings_replace_text (&prm_title_text, settings->title_text);
+  settings_replace_text (&prm_x_unit_text, settings->x_unit_text);
+  settings_replace_text (&prm_y_unit_text, settings->y_unit_text);
+  if (settings->do_draw_marks)
+    default_draw_marks = TRUE;
+}
+
+/* Go back to the settings of the command line, so that the directives
+   of one plot don't change the next */
+static void
+server_settings_restore (void)
+{
+  server_settings_apply (&startup_settings);
+  default_draw_marks = startup_settings.do_draw_marks;
+}
+
+static void
+server_settings_free (server_settings_t * settings)
+{
+  g_free (settings->title_text);
+  g_free (settings->x_unit_text);
+  g_free (settings->y_unit_text);
+}
+
+/* Read a data file and find the settings that its directives change */
+static void
+server_read_settings (char *filename, server_settings_t * settings)
+{
+  server_settings_t current;
+
+  current.title_text = prm_title_text;
+  current.x_unit_text = prm_x_unit_text;
+  current.y_unit_text = prm_y_unit_text;
+  current.do_draw_marks = default_draw_marks;
+  prm_title_text = prm_x_unit_text = prm_y_unit_text = NULL;
+  default_draw_marks = FALSE;
+
+  read_data_sets (1, &filename);
+
+  settings->title_text = prm_title_text;
+  settings->x_unit_text = prm_x_unit_text;
+  settings->y_unit_text = prm_y_unit_text;
+  settings->do_draw_marks = default_draw_marks;
+  prm_title_text = current.title_text;
+  prm_x_unit_text = current.x_unit_text;
+  prm_y_unit_text = current.y_unit_text;
+  default_draw_marks = current.do_draw_marks;
+}
+
+static void
+server_file_free (gpointer data)
+{
+  server_file_t *file = data;
+  guint ds_idx;
+
+  for (ds_idx = 0; ds_idx < file->datasets->len; ds_idx++)
+    g_ptr_array_add (retired_datasets,
+		     g_ptr_array_index (file->datasets, ds_idx));
+  g_ptr_array_free (file->datasets, TRUE);
+  server_settings_free (&file->settings);
+  g_free (file->name);
+  g_free (file);
+}
+
+/* The datasets read since first_id */
+static GPtrArray *
+server_new_datasets (guint first_id)
+{
+  GPtrArray *datasets = g_ptr_array_new ();
+  guint id;
+
+  for (id = first_id; id < dataset_table->len; id++)
+    if (g_ptr_array_index (dataset_table, id))
+      g_ptr_array_add (datasets, g_ptr_array_index (dataset_table, id));
+
+  return datasets;
+}
+
+/* Add the datasets of a data file to the plot, reading the file only
+   if it has changed. The sets are also read again when they would get
+   other colors or names than when they were read. */
+static gboolean
+server_add_file (const char *cwd, char *filename, GPtrArray * datasets,
+		 GString * reply)
+{
+  gchar *path = g_path_is_absolute (filename)
+    ? g_strdup (filename) : g_build_filename (cwd, filename, NULL);
+  server_file_t *file = g_hash_table_lookup (file_cache, path);
+  struct stat st;
+  guint ds_idx;
+
+  if (stat (path, &st) != 0 || S_ISDIR (st.st_mode)
+      || access (path, R_OK) != 0)
+    {
+      g_string_append_printf (reply, "Warning! Couldn't open %s!\n",
+			      filename);
+      g_free (path);
+      return FALSE;
+    }
+
+  if (file
+      && (file->mtime != st.st_mtime || file->size != st.st_size
+	  || file->ino != st.st_ino || strcmp (file->name, filename) != 0
+	  || file->first_set_idx != num_datasets))
+    {
+      g_hash_table_remove (file_cache, path);
+      file = NULL;
+    }
+
+  if (file)
+    {
+      num_datasets += file->num_sets;
+      g_free (path);
+    }
+  else
+    {
+      guint first_id = dataset_table->len;
+
+      /* A file written while it is read is read again next time */
+      file = g_new0 (server_file_t, 1);
+      file->name = g_strdup (filename);
+      file->mtime = st.st_mtime;
+      file->size = st.st_size;
+      file->ino = st.st_ino;
+      file->first_set_idx = num_datasets;
+      server_read_settings (filename, &file->settings);
+      file->num_sets = num_datasets - file->first_set_idx;
+      file->datasets = server_new_datasets (first_id);
+      g_hash_table_insert (file_cache, path, file);
+    }
+
+  file->last_use = num_requests;
+  server_settings_apply (&file->settings);
+  for (ds_idx = 0; ds_idx < file->datasets->len; ds_idx++)
+    g_ptr_array_add (datasets, g_ptr_array_index (file->datasets, ds_idx));
+
+  return TRUE;
+}
+
+/* Add the data sent by the client to the plot. It isn't kept after
+   the plot. */
+static void
+server_add_data (const gchar * data, gsize len, GPtrArray * datasets)
+{
+  gxgraph_arena_t *arena = gxgraph_arena_new ();
+  loader_t *loader = loader_new ("(stdin)", arena, LOADER_FILE);
+  guint first_id = dataset_table->len;
+  GPtrArray *new_datasets;
+  gsize pos = 0;
+  guint ds_idx;
+
+  while (pos < len)
+    {
+      char S_[SERVER_MAX_LINE];
+      const gchar *newline = memchr (data + pos, '\n',
+				     MIN (len - pos, sizeof (S_) - 1));
+      gsize line_len;
+
+      /* Lines are split like fgets() does */
+      if (newline)
+	line_len = newline - (data + pos) + 1;
+      else
+	line_len = MIN (len - pos, sizeof (S_) - 1);
+
+      memcpy (S_, data + pos, line_len);
+      S_[line_len] = '\0';
+      loader_parse_line (loader, S_);
+      pos += line_len;
+    }
+  loader_free (loader);
+  gxgraph_arena_unref (arena);
+  finish_data_sets (first_id);
+
+  new_datasets = server_new_datasets (first_id);
+  for (ds_idx = 0; ds_idx < new_datasets->len; ds_idx++)
+    {
+      g_ptr_array_add (datasets, g_ptr_array_index (new_datasets, ds_idx));
+      g_ptr_array_add (retired_datasets,
+		       g_ptr_array_index (new_datasets, ds_idx));
+    }
+  g_ptr_array_free (new_datasets, TRUE);
+}
+
+/* Forget the files that haven't been plotted for the longest time,
+   and delete the datasets that are no longer cached once no window
+   shows them. Datasets of windows that were closed since the last
+   request are deleted now as well. */
+static void
+server_collect_datasets (void)
+{
+  guint ds_idx;
+
+  while (g_hash_table_size (file_cache) > SERVER_MAX_CACHED_FILES)
+    {
+      GHashTableIter iter;
+      gpointer path, data;
+      gchar *oldest_path = NULL;
+      guint oldest_use = num_requests;
+
+      g_hash_table_iter_init (&iter, file_cache);
+      while (g_hash_table_iter_next (&iter, &path, &data))
+	if (((server_file_t *) data)->last_use < oldest_use)
+	  {
+	    oldest_path = path;
+	    oldest_use = ((server_file_t *) data)->last_use;
+	  }
+
+      /* All the files are of the current plot */
+      if (!oldest_path)
+	break;
+      g_hash_table_remove (file_cache, oldest_path);
+    }
+
+  for (ds_idx = retired_datasets->len; ds_idx-- > 0;)
+    {
+      dataset_t *dataset = g_ptr_array_index (retired_datasets, ds_idx);
+
+      if (gxgraph_is_dataset_shown (dataset))
+	continue;
+      g_ptr_array_remove_index_fast (retired_datasets, ds_idx);
+      dataset_table_remove (dataset);
+    }
+}
+
+/* Plot the request of a client. Returns whether it was plotted, and
+   the warnings for the client in reply. */
+static gboolean
+server_plot (const gchar * request, gsize len, GString * reply)
+{
+  const gchar *header_end = g_strstr_len (request, len, "\n\n");
+  gchar *header;
+  gchar **args;
+  GPtrArray *datasets;
+  char *output_filename = NULL;
+  int width = 0, height = 0;
+  int num_files = 0;
+  gboolean is_ok = TRUE;
+  int idx;
+
+  if (!header_end)
+    {
+      g_string_append (reply, "Warning! The request is broken!\n");
+      return FALSE;
+    }
+  header = g_strndup (request, header_end - request);
+  args = g_strsplit (header, "\n", -1);
+  g_free (header);
+
+  /* The files are named relative to the client */
+  if (chdir (args[0]) != 0)
+    {
+      g_string_append_printf (reply, "Warning! Couldn't change to %s: %s\n",
+			      args[0], g_strerror (errno));
+      g_strfreev (args);
+      return FALSE;
+    }
+
+  for (idx = 1; args[idx]; idx++)
+    {
+      if (strcmp (args[idx], "-o") == 0 && args[idx + 1])
+	output_filename = args[++idx];
+      else if (strcmp (args[idx], "-size") == 0 && args[idx + 1])
+	{
+	  if (sscanf (args[++idx], "%dx%d", &width, &height) != 2)
+	    {
+	      g_string_append (reply, "Size should be given as WxH!\n");
+	      is_ok = FALSE;
+	    }
+	}
+      else if (args[idx][0] == '-')
+	{
+	  g_string_append_printf (reply, "Unknown option %s!\n", args[idx]);
+	  is_ok = FALSE;
+	}
+      else
+	num_files++;
+    }
+  if (!output_filename && !server_has_display)
+    {
+      g_string_append (reply, "The server has no display, and can only "
+		       "render to files with -o!\n");
+      is_ok = FALSE;
+    }
+  if (!is_ok)
+    {
+      g_strfreev (args);
+      return FALSE;
+    }
+
+  num_requests++;
+  num_datasets = 0;
+  server_settings_restore ();
+  datasets = g_ptr_array_new ();
+  for (idx = 1; args[idx]; idx++)
+    {
+      if (strcmp (args[idx], "-o") == 0 || strcmp (args[idx], "-size") == 0)
+	idx++;
+      else if (!server_add_file (args[0], args[idx], datasets, reply))
+	is_ok = FALSE;
+    }
+
+  /* A plot without all of its files would look complete */
+  if (!is_ok)
+    {
+      g_ptr_array_free (datasets, TRUE);
+      g_strfreev (args);
+      server_collect_datasets ();
+      return FALSE;
+    }
+
+  if (num_files == 0)
+    server_add_data (header_end + 2, len - (header_end + 2 - request),
+		     datasets);
+
+  if (output_filename)
+    {
+      window_t *window = new_headless_window ();
+
+      if (width > 0 && height > 0)
+	{
+	  window->width = width;
+	  window->height = height;
+	}
+      put_datasets_in_window (datasets, window, NULL);
+      if (gxgraph_export (window, output_filename) != 0)
+	{
+	  g_string_append_printf (reply, "Couldn't render %s!\n",
+				  output_filename);
+	  is_ok = FALSE;
+	}
+      g_ptr_array_free (window->datasets, TRUE);
+      g_free (window);
+    }
+  else
+    gxgraph_add_window (datasets, width, height);
+
+  g_ptr_array_free (datasets, TRUE);
+  g_strfreev (args);
+  server_collect_datasets ();
+
+  return is_ok;
+}
+
+/* Write all of buf, or fail */
+static gboolean
+write_all (int fd, const gchar * buf, gsize len)
+{
+  while (len > 0)
+    {
+      ssize_t num_written = write (fd, buf, len);
+
+      if (num_written < 0 && errno == EINTR)
+	continue;
+      if (num_written <= 0)
+	return FALSE;
+      buf += num_written;
+      len -= num_written;
+    }
+
+  return TRUE;
+}
+
+static void
+client_free (server_client_t * client)
+{
+  if (client->watch_id)
+    g_source_remove (client->watch_id);
+  g_io_channel_unref (client->channel);
+  g_string_free (client->request, TRUE);
+  g_free (client);
+}
+
+static gboolean
+cb_client_input (GIOChannel * channel, GIOCondition condition,
+		 gpointer user_data)
+{
+  server_client_t *client = user_data;
+  gchar buf[SERVER_READ_SIZE];
+  gsize num_read = 0;
+  GIOStatus status;
+  GString *reply;
+  int fd;
+
+  status = g_io_channel_read_chars (channel, buf, sizeof (buf), &num_read,
+				    NULL);
+  if (num_read > 0)
+    g_string_append_len (client->request, buf, num_read);
+  if (client->request->len > SERVER_MAX_REQUEST)
+    {
+      fprintf (stderr, "Warning! Dropping a client of %s that sent more "
+	       "than %d bytes!\n", server_path, SERVER_MAX_REQUEST);
+      client->watch_id = 0;
+      client_free (client);
+      return FALSE;
+    }
+  if (status == G_IO_STATUS_ERROR)
+    {
+      fprintf (stderr, "Warning! Lost a client of %s!\n", server_path);
+      client->watch_id = 0;
+      client_free (client);
+      return FALSE;
+    }
+  if (status != G_IO_STATUS_EOF)
+    return TRUE;
+
+  /* The client has sent all of its request */
+  reply = g_string_new (NULL);
+  if (server_plot (client->request->str, client->request->len, reply))
+    g_string_append (reply, "OK\n");
+  else
+    g_string_append (reply, "FAILED\n");
+
+  fd = g_io_channel_unix_get_fd (channel);
+  fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_NONBLOCK);
+  write_all (fd, reply->str, reply->len);
+  g_string_free (reply, TRUE);
+
+  client->watch_id = 0;
+  client_free (client);
+
+  return FALSE;
+}
+
+static gboolean
+cb_accept (GIOChannel * channel, GIOCondition condition, gpointer user_data)
+{
+  int fd = accept (g_io_channel_unix_get_fd (channel), NULL, NULL);
+  server_client_t *client;
+
+  if (fd < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+	fprintf (stderr, "Warning! Couldn't accept a connection on %s: %s\n",
+		 server_path, g_strerror (errno));
+      return TRUE;
+    }
+
+  client = g_new0 (server_client_t, 1);
+  client->channel = g_io_channel_unix_new (fd);
+  g_io_channel_set_encoding (client->channel, NULL, NULL);
+  g_io_channel_set_buffered (client->channel, FALSE);
+  g_io_channel_set_flags (client->channel, G_IO_FLAG_NONBLOCK, NULL);
+  g_io_channel_set_close_on_unref (client->channel, TRUE);
+  client->request = g_string_new (NULL);
+  client->watch_id = g_io_add_watch (client->channel,
+				     G_IO_IN | G_IO_HUP | G_IO_ERR,
+				     cb_client_input, client);
+
+  return TRUE;
+}
+#endif
+
+/* Serve the clients that connect to the socket at path, which is
+   created. Without a display the plots can only be rendered to files. */
+gboolean
+gxgraph_server_start (const char *path, gboolean has_display)
+{
+#ifdef G_OS_UNIX
+  int fd = gxgraph_listen_socket_open (path);
+
+  if (fd < 0)
+    return FALSE;
+
+  /* A client that goes away mustn't take the server with it */
+  signal (SIGPIPE, SIG_IGN);
+
+  server_path = g_strdup (path);
+  server_has_display = has_display;
+  if (!dataset_table)
+    dataset_table = g_ptr_array_new ();
+  file_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+				      server_file_free);
+  retired_datasets = g_ptr_array_new ();
+
+  /* The texts may be in argv, and are replaced by copies that can be
+     freed */
+  startup_settings.title_text = g_strdup (prm_title_text);
+  startup_settings.x_unit_text = g_strdup (prm_x_unit_text);
+  startup_settings.y_unit_text = g_strdup (prm_y_unit_text);
+  startup_settings.do_draw_marks = default_draw_marks;
+  prm_title_text = g_strdup (prm_title_text);
+  prm_x_unit_text = g_strdup (prm_x_unit_text);
+  prm_y_unit_text = g_strdup (prm_y_unit_text);
+
+  server_channel = g_io_channel_unix_new (fd);
+  g_io_channel_set_close_on_unref (server_channel, TRUE);
+  g_io_add_watch (server_channel, G_IO_IN, cb_accept, NULL);
+
+  return TRUE;
+#else
+  fprintf (stderr, "Warning! The server needs Unix sockets.\n");
+  return FALSE;
+#endif
+}
+
+/* Send the command line and data to the server at path, and print the
+   warnings that it replies with. Returns the exit status. */
+int
+gxgraph_client_run (const char *path, int argc, char *argv[])
+{
+#ifdef G_OS_UNIX
+  struct sockaddr_un addr;
+  GString *request;
+  gchar buf[SERVER_READ_SIZE];
+  gchar *cwd;
+  gchar *status;
+  gboolean do_stdin = TRUE;
+  ssize_t num_read;
+  int argp;
+  int fd;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "The socket path %s is too long!\n", path);
+      return 1;
+    }
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect (fd, (struct sockaddr *) &addr, sizeof (addr)) != 0)
+    {
+      fprintf (stderr, "Couldn't connect to the gxgraph server at %s: %s\n",
+	       path, g_strerror (errno));
+      return 1;
+    }
+  signal (SIGPIPE, SIG_IGN);
+
+  cwd = g_get_current_dir ();
+  request = g_string_new (cwd);
+  g_string_append_c (request, '\n');
+  g_free (cwd);
+  for (argp = 0; argp < argc; argp++)
+    {
+      if (argv[argp][0] == '\0' || strchr (argv[argp], '\n'))
+	{
+	  fprintf (stderr, "Can't send the argument \"%s\"!\n", argv[argp]);
+	  return 1;
+	}
+      g_string_append_printf (request, "%s\n", argv[argp]);
+      if ((strcmp (argv[argp], "-o") == 0
+	   || strcmp (argv[argp], "-size") == 0) && argp + 1 < argc)
+	g_string_append_printf (request, "%s\n", argv[++argp]);
+      else if (argv[argp][0] != '-')
+	do_stdin = FALSE;
+    }
+  g_string_append_c (request, '\n');
+
+  if (!write_all (fd, request->str, request->len))
+    {
+      fprintf (stderr, "Couldn't send to the gxgraph server at %s: %s\n",
+	       path, g_strerror (errno));
+      return 1;
+    }
+  g_string_free (request, TRUE);
+
+  while (do_stdin && (num_read = read (0, buf, sizeof (buf))) != 0)
+    {
+      if (num_read < 0 && errno == EINTR)
+	continue;
+      if (num_read < 0 || !write_all (fd, buf, num_read))
+	{
+	  fprintf (stderr, "Couldn't send the data to the gxgraph server "
+		   "at %s: %s\n", path, g_strerror (errno));
+	  return 1;
+	}
+    }
+  shutdown (fd, SHUT_WR);
+
+  /* The server replies once it has plotted */
+  request = g_string_new (NULL);
+  while ((num_read = read (fd, buf, sizeof (buf))) != 0)
+    {
+      if (num_read < 0 && errno == EINTR)
+	continue;
+      if (num_read < 0)
+	break;
+      g_string_append_len (request, buf, num_read);
+    }
+  close (fd);
+
+  /* The last line is the status, and the others are warnings */
+  g_strchomp (request->str);
+  status = strrchr (request->str, '\n');
+  if (status)
+    {
+      *status++ = '\0';
+      fprintf (stderr, "%s\n", request->str);
+    }
+  else
+    status = request->str;
+  if (strcmp (status, "OK") != 0)
+    {
+      if (strcmp (status, "FAILED") != 0)
+	fprintf (stderr, "The gxgraph server at %s didn't reply!\n", path);
+      return 1;
+    }
+
+  return 0;
+#else
+  fprintf (stderr, "The gxgraph client needs Unix sockets.\n");
+  return 1;
+#endif
+}
@@ -0,0 +1,18 @@
+/*======================================================================
+//  gxgraph_server.h - Keep one gxgraph running that plots the data
+//  sent to it by short lived clients.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_SERVER_H
+#define GXGRAPH_SERVER_H
+
+#include <glib.h>
+
+gboolean gxgraph_server_start (const char *path, gboolean has_display);
+int gxgraph_client_run (const char *path, int argc, char *argv[]);
+
+#endif /* GXGRAPH_SERVER */
@@ -0,0 +1,188 @@
+/*======================================================================
+//  gxgraph_spill.c - Points of a dataset kept in a memory mapped
+//  temporary file, for data that doesn't fit in memory.
+//
+//  The points are written to the file while loading and the file is
+//  mapped read only when the dataset is complete. The bounding box of
+//  each chunk of points is kept in memory so that drawing only needs
+//  to page in the chunks that are visible.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <glib/gstdio.h>
+#include "gxgraph_spill.h"
+
+struct gxgraph_spill_t_struct
+{
+  gint ref_count;
+  gchar *filename;
+  FILE *OUT;
+  GMappedFile *mapped;
+  gsize element_size;
+  guint num_elements;
+
+  /* Each chunk also covers the last point of the chunk before it, so
+     that a chunk outside the view has no visible segments. */
+  GArray *chunks;
+  double last_x, last_y;
+};
+
+/* Returns NULL if no temporary file could be created */
+gxgraph_spill_t *
+gxgraph_spill_new (gsize element_size)
+{
+  gxgraph_spill_t *spill;
+  GError *error = NULL;
+  gchar *filename;
+  gint fd;
+
+  fd = g_file_open_tmp ("gxgraph-spill-XXXXXX", &filename, &error);
+  if (fd < 0)
+    {
+      fprintf (stderr, "Couldn't create a spill file: %s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  spill = g_new0 (gxgraph_spill_t, 1);
+  spill->ref_count = 1;
+  spill->filename = filename;
+  spill->OUT = fdopen (fd, "wb");
+  spill->element_size = element_size;
+  spill->chunks = g_array_new (FALSE, FALSE, sizeof (spill_chunk_t));
+
+  return spill;
+}
+
+gxgraph_spill_t *
+gxgraph_spill_ref (gxgraph_spill_t * spill)
+{
+  g_atomic_int_inc (&spill->ref_count);
+
+  return spill;
+}
+
+void
+gxgraph_spill_unref (gxgraph_spill_t * spill)
+{
+  if (!g_atomic_int_dec_and_test (&spill->ref_count))
+    return;
+
+  if (spill->OUT)
+    fclose (spill->OUT);
+  if (spill->mapped)
+#if GLIB_CHECK_VERSION(2,22,0)
+    g_mapped_file_unref (spill->mapped);
+#else
+    g_mapped_file_free (spill->mapped);
+#endif
+  g_unlink (spill->filename);
+  g_free (spill->filename);
+  g_array_free (spill->chunks, TRUE);
+  g_free (spill);
+}
+
+/* Add an element with the given position to the end of the file */
+gboolean
+gxgraph_spill_append (gxgraph_spill_t * spill, gconstpointer element,
+		      double x, double y)
+{
+  spill_chunk_t *chunk;
+
+  if (fwrite (element, spill->element_size, 1, spill->OUT) != 1)
+    return FALSE;
+
+  if ((spill->num_elements & (SPILL_CHUNK_SIZE - 1)) == 0)
+    {
+      spill_chunk_t new_chunk;
+
+      new_chunk.x0 = new_chunk.x1 = x;
+      new_chunk.y0 = new_chunk.y1 = y;
+      if (spill->num_elements > 0)
+	{
+	  new_chunk.x0 = MIN (x, spill->last_x);
+	  new_chunk.x1 = MAX (x, spill->last_x);
+	  new_chunk.y0 = MIN (y, spill->last_y);
+	  new_chunk.y1 = MAX (y, spill->last_y);
+	}
+      g_array_append_val (spill->chunks, new_chunk);
+    }
+  else
+    {
+      chunk = &g_array_index (spill->chunks, spill_chunk_t,
+			      spill->chunks->len - 1);
+      if (x < chunk->x0)
+	chunk->x0 = x;
+      if (x > chunk->x1)
+	chunk->x1 = x;
+      if (y < chunk->y0)
+	chunk->y0 = y;
+      if (y > chunk->y1)
+	chunk->y1 = y;
+    }
+
+  spill->last_x = x;
+  spill->last_y = y;
+  spill->num_elements++;
+
+  return TRUE;
+}
+
+/* Close the file and map it. Returns the elements, or NULL if the
+   file couldn't be mapped. */
+const gchar *
+gxgraph_spill_finish (gxgraph_spill_t * spill)
+{
+  GError *error = NULL;
+
+  if (spill->OUT)
+    {
+      if (fclose (spill->OUT) != 0)
+	fprintf (stderr, "Failed writing the spill file %s!\n",
+		 spill->filename);
+      spill->OUT = NULL;
+    }
+  if (spill->num_elements == 0)
+    return NULL;
+
+  if (!spill->mapped)
+    {
+      spill->mapped = g_mapped_file_new (spill->filename, FALSE, &error);
+      if (!spill->mapped)
+	{
+	  fprintf (stderr, "Couldn't map the spill file: %s\n",
+		   error->message);
+	  g_error_free (error);
+	  return NULL;
+	}
+#ifdef G_OS_UNIX
+      /* Nothing is left behind if we are killed */
+      g_unlink (spill->filename);
+#endif
+    }
+
+  return g_mapped_file_get_contents (spill->mapped);
+}
+
+guint
+gxgraph_spill_get_num_chunks (gxgraph_spill_t * spill)
+{
+  return spill->chunks->len;
+}
+
+const spill_chunk_t *
+gxgraph_spill_get_chunk (gxgraph_spill_t * spill, guint chunk_idx)
+{
+  return &g_array_index (spill->chunks, spill_chunk_t, chunk_idx);
+}
+
+/* Bytes of the file */
+gsize
+gxgraph_spill_get_size (gxgraph_spill_t * spill)
+{
+  return (gsize) spill->num_elements * spill->element_size;
+}
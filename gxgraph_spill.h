@@ -0,0 +1,37 @@
+/*======================================================================
+//  gxgraph_spill.h - Points of a dataset kept in a memory mapped
+//  temporary file, for data that doesn't fit in memory.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_SPILL_H
+#define GXGRAPH_SPILL_H
+
+#include <glib.h>
+
+/* Number of points in a chunk with its own bounding box */
+#define SPILL_CHUNK_SHIFT 16
+#define SPILL_CHUNK_SIZE (1 << SPILL_CHUNK_SHIFT)
+
+typedef struct
+{
+  double x0, y0, x1, y1;
+} spill_chunk_t;
+
+typedef struct gxgraph_spill_t_struct gxgraph_spill_t;
+
+gxgraph_spill_t *gxgraph_spill_new (gsize element_size);
+gxgraph_spill_t *gxgraph_spill_ref (gxgraph_spill_t * spill);
+void gxgraph_spill_unref (gxgraph_spill_t * spill);
+gboolean gxgraph_spill_append (gxgraph_spill_t * spill,
+			       gconstpointer element, double x, double y);
+const gchar *gxgraph_spill_finish (gxgraph_spill_t * spill);
+guint gxgraph_spill_get_num_chunks (gxgraph_spill_t * spill);
+const spill_chunk_t *gxgraph_spill_get_chunk (gxgraph_spill_t * spill,
+					      guint chunk_idx);
+gsize gxgraph_spill_get_size (gxgraph_spill_t * spill);
+
+#endif /* GXGRAPH_SPILL */
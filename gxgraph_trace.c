@@ -0,0 +1,113 @@
+/*======================================================================
+//  gxgraph_trace.c - Tracing of where the time is spent, written in
+//  the Chrome trace event format. Load the output in chrome://tracing
+//  or any other viewer of that format.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gxgraph_trace.h"
+
+gboolean gxgraph_trace_is_enabled = FALSE;
+
+static FILE *TRACE = NULL;
+static gint64 start_time;
+static int num_events = 0;
+
+/* Small and stable thread ids for the viewer */
+static GHashTable *thread_ids = NULL;
+
+G_LOCK_DEFINE_STATIC (trace);
+
+int
+gxgraph_trace_open (const char *filename)
+{
+  if (TRACE)
+    gxgraph_trace_close ();
+
+  TRACE = fopen (filename, "w");
+  if (!TRACE)
+    {
+      fprintf (stderr, "Couldn't open %s for writing!\n", filename);
+      return -1;
+    }
+
+  fprintf (TRACE, "{\"traceEvents\": [");
+  thread_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+  start_time = g_get_monotonic_time ();
+  num_events = 0;
+  gxgraph_trace_is_enabled = TRUE;
+  atexit (gxgraph_trace_close);
+
+  return 0;
+}
+
+void
+gxgraph_trace_close (void)
+{
+  if (!TRACE)
+    return;
+
+  G_LOCK (trace);
+  gxgraph_trace_is_enabled = FALSE;
+  fprintf (TRACE, "\n],\n\"displayTimeUnit\": \"ms\"}\n");
+  fclose (TRACE);
+  TRACE = NULL;
+  g_hash_table_destroy (thread_ids);
+  thread_ids = NULL;
+  G_UNLOCK (trace);
+}
+
+static void
+write_escaped (FILE * OUT, const char *s)
+{
+  for (; *s; s++)
+    {
+      if (*s == '"' || *s == '\\')
+	fprintf (OUT, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+	fprintf (OUT, "\\u%04x", *s);
+      else
+	fputc (*s, OUT);
+    }
+}
+
+void
+gxgraph_trace_event (const char *name, const char *detail, char phase)
+{
+  gint64 now = g_get_monotonic_time ();
+  gpointer self = g_thread_self ();
+  int tid;
+
+  G_LOCK (trace);
+  if (!TRACE)
+    {
+      G_UNLOCK (trace);
+      return;
+    }
+
+  tid = GPOINTER_TO_INT (g_hash_table_lookup (thread_ids, self));
+  if (!tid)
+    {
+      tid = g_hash_table_size (thread_ids) + 1;
+      g_hash_table_insert (thread_ids, self, GINT_TO_POINTER (tid));
+    }
+
+  fprintf (TRACE,
+	   "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %" G_GINT64_FORMAT
+	   ", \"pid\": 1, \"tid\": %d",
+	   num_events++ ? "," : "", name, phase, now - start_time, tid);
+  if (detail)
+    {
+      fprintf (TRACE, ", \"args\": {\"detail\": \"");
+      write_escaped (TRACE, detail);
+      fprintf (TRACE, "\"}");
+    }
+  fprintf (TRACE, "}");
+  G_UNLOCK (trace);
+}
@@ -0,0 +1,35 @@
+/*======================================================================
+//  gxgraph_trace.h - Tracing of where the time is spent, written in
+//  the Chrome trace event format.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef GXGRAPH_TRACE_H
+#define GXGRAPH_TRACE_H
+
+#include <glib.h>
+
+extern gboolean gxgraph_trace_is_enabled;
+
+int gxgraph_trace_open (const char *filename);
+void gxgraph_trace_close (void);
+void gxgraph_trace_event (const char *name, const char *detail, char phase);
+
+/* Spans must be ended with the same name in the same thread. When
+   tracing is off these only cost a test of a global. */
+#define TRACE_BEGIN(name, detail)					\
+  do {									\
+    if (G_UNLIKELY (gxgraph_trace_is_enabled))				\
+      gxgraph_trace_event (name, detail, 'B');				\
+  } while (0)
+
+#define TRACE_END(name)							\
+  do {									\
+    if (G_UNLIKELY (gxgraph_trace_is_enabled))				\
+      gxgraph_trace_event (name, NULL, 'E');				\
+  } while (0)
+
+#endif /* GXGRAPH_TRACE */
@@ -0,0 +1,215 @@
+/*======================================================================
+//  null_painter.c - A painter that draws nothing but counts the calls
+//  and the number of elements of each drawing operation. This shows
+//  the cost of everything but the rasterization, and catches drawing
+//  that is done one point at a time.
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#include <stdio.h>
+#include <string.h>
+#include "gxgraph.h"
+#include "null_painter.h"
+
+enum
+{
+  OP_COUNT_SET_ATTRIBUTES,
+  OP_COUNT_SET_ATTRIBUTES_STYLE,
+  OP_COUNT_DRAW_SEGMENTS,
+  OP_COUNT_DRAW_MARKS,
+  OP_COUNT_DRAW_TEXT,
+  OP_COUNT_DRAW_LINE,
+  OP_COUNT_GROUP,
+  OP_COUNT_NUM
+};
+
+static const char *op_count_names[OP_COUNT_NUM] = {
+  "set_attributes",
+  "set_attributes_style",
+  "draw_segments",
+  "draw_marks",
+  "draw_text",
+  "draw_line",
+  "group_start",
+};
+
+/* What the elements of each operation are */
+static const char *op_count_element_names[OP_COUNT_NUM] = {
+  NULL,
+  NULL,
+  "segments",
+  "marks",
+  "chars",
+  NULL,
+  NULL,
+};
+
+typedef struct
+{
+  painter_t painter;
+
+  glong num_calls[OP_COUNT_NUM];
+  glong num_elements[OP_COUNT_NUM];
+} null_painter_t;
+
+/* Same layout as the screen */
+#define PADDING         10
+#define SPACE           10
+#define TICKLENGTH      5
+
+static void
+null_painter_set_attributes (painter_t * painter,
+			     GdkColor color,
+			     double line_width,
+			     int line_style,
+			     gint mark_type,
+			     gdouble mark_size_x, gdouble mark_size_y);
+static void null_painter_set_attributes_style (painter_t * painter,
+					       int style);
+static void null_painter_draw_line (painter_t * painter,
+				    double x1, double y1,
+				    double x2, double y2);
+static void null_painter_draw_segments (painter_t * painter,
+					GArray * segments);
+static void null_painter_draw_marks (painter_t * painter, GArray * marks);
+static void null_painter_draw_text (painter_t * painter,
+				    double x_pos, double y_pos,
+				    const char *text, int just, int style);
+static void null_painter_group_start (painter_t * painter,
+				      const char *group_name);
+static void null_painter_group_end (painter_t * painter,
+				    const char *group_name);
+
+painter_t *
+null_painter_new (window_t * window)
+{
+  null_painter_t *this = g_new0 (null_painter_t, 1);
+  painter_t *parent = (painter_t *) this;
+
+  parent->set_attributes = null_painter_set_attributes;
+  parent->set_attributes_style = null_painter_set_attributes_style;
+  parent->draw_segments = null_painter_draw_segments;
+  parent->draw_marks = null_painter_draw_marks;
+  parent->draw_line = null_painter_draw_line;
+  parent->draw_text = null_painter_draw_text;
+  parent->group_start = null_painter_group_start;
+  parent->group_end = null_painter_group_end;
+
+  parent->area_w = window->width;
+  parent->area_h = window->height;
+  parent->bdr_pad = PADDING;
+  parent->axis_pad = SPACE;
+  parent->legend_pad = 0;
+  parent->tick_len = TICKLENGTH;
+  parent->axis_width = 5;
+  parent->axis_height = 13;
+  parent->title_width = 5;
+  parent->title_height = 5;
+  parent->units_per_inch = 96;
+
+  return parent;
+}
+
+void
+null_painter_delete (painter_t * painter)
+{
+  g_free (painter);
+}
+
+void
+null_painter_reset (painter_t * painter)
+{
+  null_painter_t *null_painter = (null_painter_t *) painter;
+
+  memset (null_painter->num_calls, 0, sizeof (null_painter->num_calls));
+  memset (null_painter->num_elements, 0,
+	  sizeof (null_painter->num_elements));
+}
+
+void
+null_painter_print_summary (painter_t * painter, FILE * OUT, double seconds)
+{
+  null_painter_t *null_painter = (null_painter_t *) painter;
+  int op;
+
+  fprintf (OUT, "%-22s %10s %12s\n", "operation", "calls", "elements");
+  for (op = 0; op < OP_COUNT_NUM; op++)
+    {
+      fprintf (OUT, "%-22s %10ld", op_count_names[op],
+	       null_painter->num_calls[op]);
+      if (op_count_element_names[op])
+	fprintf (OUT, " %12ld %s", null_painter->num_elements[op],
+		 op_count_element_names[op]);
+      fprintf (OUT, "\n");
+    }
+  if (seconds >= 0)
+    fprintf (OUT, "%-22s %10.3f ms\n", "time", seconds * 1000);
+}
+
+static void
+null_painter_set_attributes (painter_t * painter,
+			     GdkColor color,
+			     double line_width,
+			     int line_style,
+			     gint mark_type,
+			     gdouble mark_size_x, gdouble mark_size_y)
+{
+  ((null_painter_t *) painter)->num_calls[OP_COUNT_SET_ATTRIBUTES]++;
+}
+
+static void
+null_painter_set_attributes_style (painter_t * painter, int style)
+{
+  ((null_painter_t *) painter)->num_calls[OP_COUNT_SET_ATTRIBUTES_STYLE]++;
+}
+
+static void
+null_painter_draw_line (painter_t * painter,
+			double x1, double y1, double x2, double y2)
+{
+  ((null_painter_t *) painter)->num_calls[OP_COUNT_DRAW_LINE]++;
+}
+
+static void
+null_painter_draw_segments (painter_t * painter, GArray * segments)
+{
+  null_painter_t *null_painter = (null_painter_t *) painter;
+
+  null_painter->num_calls[OP_COUNT_DRAW_SEGMENTS]++;
+  null_painter->num_elements[OP_COUNT_DRAW_SEGMENTS] += segments->len;
+}
+
+static void
+null_painter_draw_marks (painter_t * painter, GArray * marks)
+{
+  null_painter_t *null_painter = (null_painter_t *) painter;
+
+  null_painter->num_calls[OP_COUNT_DRAW_MARKS]++;
+  null_painter->num_elements[OP_COUNT_DRAW_MARKS] += marks->len;
+}
+
+static void
+null_painter_draw_text (painter_t * painter,
+			double x_pos, double y_pos,
+			const char *text, int just, int style)
+{
+  null_painter_t *null_painter = (null_painter_t *) painter;
+
+  null_painter->num_calls[OP_COUNT_DRAW_TEXT]++;
+  if (text)
+    null_painter->num_elements[OP_COUNT_DRAW_TEXT] += strlen (text);
+}
+
+static void
+null_painter_group_start (painter_t * painter, const char *group_name)
+{
+  ((null_painter_t *) painter)->num_calls[OP_COUNT_GROUP]++;
+}
+
+static void
+null_painter_group_end (painter_t * painter, const char *group_name)
+{
+}
@@ -0,0 +1,21 @@
+/*======================================================================
+//  null_painter.h - A painter that only counts what it is asked to draw
+//
+//  Dov Grobgeld <dov.grobgeld@weizmann.ac.il>
+//
+//  Copyright: See COPYING file that comes with this distribution
+//----------------------------------------------------------------------
+*/
+#ifndef NULL_PAINTER_H
+#define NULL_PAINTER_H
+
+#include <stdio.h>
+#include "gxgraph.h"
+
+painter_t *null_painter_new (window_t * window);
+void null_painter_reset (painter_t * painter);
+void null_painter_print_summary (painter_t * painter, FILE * OUT,
+				 double seconds);
+void null_painter_delete (painter_t * painter);
+
+#endif /* NULL_PAINTER */
@@ -16,6 +16,18 @@
 
 #define NCASE(s) if (!g_ascii_strcasecmp(s, S_))
 
+/* Count of the strings allocated with malloc, for the memory
+   statistics */
+static glong num_allocs = 0;
+static glong num_alloc_bytes = 0;
+
+void
+parser_get_alloc_counts (glong * allocs, glong * bytes)
+{
+  *allocs = num_allocs;
+  *bytes = num_alloc_bytes;
+}
+
 
 /*======================================================================
 //
@@ -51,116 +63,115 @@ string_count_words (const char *string)
   return nwords;
 }
 
-char *
-string_strdup_word (const char *string, int idx)
+/* Find word idx of string. Returns where it starts and sets its
+   length, or returns NULL if there are not that many words. */
+static const char *
+string_find_word (const char *string, int idx, int *len)
 {
   const char *p = string;
-  int in_word = 0;
+  const char *word_start;
   int word_count = -1;
-  int nchr = 1;
-  char *word = NULL;
-  const char *word_start = string;
 
-  /* printf("p = 0x%x\n", p); */
   while (*p)
     {
-      /* printf("%c\n", *p); fflush(stdout); */
-      if (!in_word)
+      while (*p == ' ' || *p == '\n' || *p == '\t')
+	p++;
+      if (!*p)
+	break;
+
+      word_start = p;
+      word_count++;
+      while (*p && *p != ' ' && *p != '\n' && *p != '\t')
+	p++;
+      if (word_count == idx)
 	{
-	  if (*p != ' ' && *p != '\n' && *p != '\t')
-	    {
-	      in_word = 1;
-	      word_count++;
-	      nchr = 1;
-	      word_start = p;
-	    }
+	  *len = p - word_start;
+	  return word_start;
 	}
-      else if (in_word)
-	{
-	  if (*p == ' ' || *p == '\n' || *p == '\t')
-	    {
-	      if (idx == word_count)
-		break;
-	      in_word = 0;
-	    }
-	}
-      nchr++;
-      p++;
     }
-  if (in_word)
-    {
-      word = g_new (char, nchr);
-      strncpy (word, word_start, nchr - 1);
-      word[nchr - 1] = 0;
-    }
-  return word;
+
+  return NULL;
+}
+
+char *
+string_strdup_word (const char *string, int idx)
+{
+  int len;
+  const char *word_start = string_find_word (string, idx, &len);
+
+  if (!word_start)
+    return NULL;
+
+  num_allocs++;
+  num_alloc_bytes += len + 1;
+  return g_strndup (word_start, len);
+}
+
+/* Copy word idx of string into a buffer of the given size, without
+   allocating. Returns FALSE, with an empty word, if there is none. */
+gboolean
+string_copy_word (const char *string, int idx, char *word, int size)
+{
+  int len;
+  const char *word_start = string_find_word (string, idx, &len);
+
+  word[0] = 0;
+  if (!word_start)
+    return FALSE;
+
+  len = MIN (len, size - 1);
+  memcpy (word, word_start, len);
+  word[len] = 0;
+
+  return TRUE;
 }
 
 char *
 string_strdup_rest (const char *string, int idx)
 {
-  const char *p = string;
-  int in_word = 0;
-  int word_count = -1;
-  int nchr = 1;
-  char *word = NULL;
-  const char *word_start = string;
+  int len;
+  const char *word_start = string_find_word (string, idx, &len);
 
-  /* printf("p = 0x%x\n", p); */
-  while (*p)
-    {
-      /* printf("%c\n", *p); fflush(stdout); */
-      if (!in_word)
-	{
-	  if (*p != ' ' && *p != '\n' && *p != '\t')
-	    {
-	      in_word = 1;
-	      word_count++;
-	      nchr = 1;
-	      word_start = p;
-	    }
-	}
-      else if (in_word)
-	{
-	  if (*p == ' ' || *p == '\n' || *p == '\t')
-	    {
-	      if (idx == word_count)
-		break;
-	      in_word = 0;
-	    }
-	}
-      nchr++;
-      p++;
-    }
+  if (!word_start)
+    return NULL;
 
-  if (in_word)
-    {
-      nchr = strlen (word_start);
-      word = g_new (char, nchr + 1);
-      strncpy (word, word_start, nchr);
-      word[nchr] = 0;
-    }
-  return word;
+  num_allocs++;
+  num_alloc_bytes += strlen (word_start) + 1;
+  return g_strdup (word_start);
+}
+
+/* Like string_strdup_rest() but the copy is owned by the arena */
+char *
+string_arena_strdup_rest (gxgraph_arena_t * arena, const char *string,
+			  int idx)
+{
+  int len;
+  const char *word_start = string_find_word (string, idx, &len);
+
+  if (!word_start)
+    return NULL;
+
+  return gxgraph_arena_strdup (arena, word_start);
 }
 
 int
 string_to_atoi (const char *string, int idx)
 {
-  char *word = string_strdup_word (string, idx);
-  int value = atoi (word);
-  g_free (word);
+  char word[256];
+
+  string_copy_word (string, idx, word, sizeof (word));
 
-  return value;
+  return atoi (word);
 }
 
 gdouble
 string_to_atof (const char *string, int idx)
 {
-  char *word = string_strdup_word (string, idx);
-  gdouble value = atof (word);
-  g_free (word);
+  char word[256];
 
-  return value;
+  string_copy_word (string, idx, word, sizeof (word));
+
+  return atof (word);
 }
 
 void
@@ -192,13 +203,13 @@ gxgraph_parse_string (const char *string, char *fn, gint linenum)
 {
   gint type = -1;
   gchar first_char = string[0];
-  gchar *first_word;
+  gchar first_word[256];
 
   /* Shortcut for speeding up drawing */
   if (first_char >= '0' && first_char <= '9')
     return STRING_DRAW;
 
-  first_word = string_strdup_word (string, 0);
+  string_copy_word (string, 0, first_word, sizeof (first_word));
 
   if (first_char == '#')
     type = STRING_COMMENT;
@@ -273,6 +284,14 @@ gxgraph_parse_string (const char *string, char *fn, gint linenum)
       {
 	type = STRING_SET_NAME;
       }
+      NCASE ("$precision")
+      {
+	type = STRING_SET_PRECISION;
+      }
+      NCASE ("$ring")
+      {
+	type = STRING_SET_RING;
+      }
       if (type == -1)
 	{
 	  fprintf (stderr, "Unknown parameter %s in file %s line %d!\n", S_,
@@ -318,8 +337,6 @@ gxgraph_parse_string (const char *string, char *fn, gint linenum)
       type = STRING_DRAW;
     }
 
-  g_free (first_word);
-
   return type;
 }
 
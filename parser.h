@@ -9,6 +9,7 @@
 #define PARSER_H
 
 #include <glib.h>
+#include "gxgraph_arena.h"
 
 enum
 {
@@ -36,12 +37,18 @@ enum
   STRING_SET_XUNIT_TEXT,
   STRING_SET_YUNIT_TEXT,
   STRING_SET_LARGE_PIXELS,
-  STRING_SET_TITLE
+  STRING_SET_TITLE,
+  STRING_SET_PRECISION,
+  STRING_SET_RING
 };
 
 gint gxgraph_parse_string (const char *string, char *fn, gint linenum);
 gint gxgraph_parse_mark_type (const char *S_, gchar * fn, gint linenum);
 char *string_strdup_rest (const char *string, int idx);
+char *string_arena_strdup_rest (gxgraph_arena_t * arena, const char *string,
+				int idx);
+gboolean string_copy_word (const char *string, int idx, char *word,
+			   int size);
 int string_to_atoi (const char *string, int idx);
 gdouble string_to_atof (const char *string, int idx);
 char *string_strdup_word (const char *string, int idx);
@@ -51,5 +58,6 @@ int    split_string_to_double_pair(const char *string,
 				   double *low,
 				   double *hi);
 void string_shorten_whitespace(char *string);
+void parser_get_alloc_counts (glong * allocs, glong * bytes);
 
 #endif /* PARSER */
@@ -87,6 +87,7 @@ ps_painter_new (window_t * window, const char *filename)
   parent->axis_height = 13;
   parent->title_width = 5;
   parent->title_height = 5;
+  parent->units_per_inch = 72;
 
   /* Open postscript file and write header to it */
   bbox[0] = (paper_width - graph_width) / 2;
@@ -102,6 +103,11 @@ ps_painter_new (window_t * window, const char *filename)
     }
   else
     this->PS = fopen (filename, "w");
+  if (!this->PS)
+    {
+      g_free (this);
+      return NULL;
+    }
   fprintf (this->PS,
 	   "%%!PS-Adobe-2.0 EPSF-2.0\n"
 	   "%%%%BoundingBox: %.0f %.0f %.0f %.0f\n"
@@ -8,6 +8,7 @@
 */
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include "gxgraph.h"
 #include "svg_painter.h"
 
@@ -16,6 +17,19 @@ typedef struct
   painter_t painter;
 
   FILE *SVG;
+  int precision;                /* Number of decimals in coordinates */
+  double unit;                  /* 10^precision */
+
+  /* Css classes and mark symbols that have already been written
+     to the file. Both map a declaration string to an index. */
+  GHashTable *classes;
+  GHashTable *symbols;
+
+  /* A path that is still open and may be extended with more
+     subpaths of the same class. */
+  int path_class;
+  gint64 path_x, path_y;
+
   /* Caching of current values */
   double current_text_size;
   double current_line_width;
@@ -51,6 +65,7 @@ static void
 svg_painter_group_end (struct painter_t_struct *painter,
                        const char *group_name);
 
+static void svg_path_flush (svg_painter_t * svg_painter);
 
 
 #define VDPI                    72.0
@@ -65,6 +80,11 @@ svg_painter_group_end (struct painter_t_struct *painter,
 #define SPACE           10
 #define TICKLENGTH      5
 
+/* Largest number of decimals that may be requested */
+#define MAX_PRECISION   6
+
+static int svg_default_precision = 2;
+
 painter_t *
 svg_painter_new (window_t * window, const char *filename)
 {
@@ -100,6 +120,7 @@ svg_painter_new (window_t * window, const char *filename)
   parent->axis_height = 13;
   parent->title_width = 5;
   parent->title_height = 5;
+  parent->units_per_inch = 96;
 
   /* Open postscript file and write header to it */
   bbox[0] = (paper_width - graph_width) / 2;
@@ -108,17 +129,40 @@ svg_painter_new (window_t * window, const char *filename)
   bbox[3] = (paper_height + graph_height) / 2;
 
   this->SVG = fopen (filename, "w");
+  if (!this->SVG)
+    {
+      g_free (this);
+      return NULL;
+    }
+  this->classes = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, NULL);
+  this->symbols = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, NULL);
+  this->path_class = -1;
+  svg_painter_set_precision (parent, svg_default_precision);
 
   fprintf (this->SVG,
            "<?xml version=\"1.0\" standalone=\"no\"?>\n"
-           "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 20000303 Stylable//EN\"\n"
+           "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
            "\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n");
 
   /* This corresponds to bounding box */
   fprintf (this->SVG,
-           "<svg width=\"%.1f\" height=\"%.1f\">\n",
+           "<svg xmlns=\"http://www.w3.org/2000/svg\""
+           " xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+           " width=\"%.1f\" height=\"%.1f\">\n",
            DEV (graph_width), DEV (graph_height));
 
+  /* Text styles. The class names are indexed by the T_AXIS and
+     T_TITLE styles. */
+  fprintf (this->SVG,
+           "<style type=\"text/css\"><![CDATA[\n"
+           "text{font-family:Helvetica,Arial,sans-serif}\n"
+           ".t%d{font-size:%.1fpx}\n"
+           ".t%d{font-size:%.1fpx}\n"
+           "]]></style>\n",
+           T_AXIS, DEV (11.0), T_TITLE, DEV (18.0));
+
   /* Set initial font... */
   this->current_text_size = 11;
 
@@ -132,13 +176,191 @@ svg_painter_delete (painter_t * painter)
 {
   svg_painter_t *svg_painter = (svg_painter_t *) painter;
 
+  svg_path_flush (svg_painter);
   fprintf (svg_painter->SVG, "</svg>\n");
 
   fclose (svg_painter->SVG);
 
+  g_hash_table_destroy (svg_painter->classes);
+  g_hash_table_destroy (svg_painter->symbols);
   g_free (svg_painter);
 }
 
+void
+svg_painter_set_precision (painter_t * painter, int precision)
+{
+  svg_painter_t *svg_painter = (svg_painter_t *) painter;
+
+  svg_painter->precision = CLAMP (precision, 0, MAX_PRECISION);
+  svg_painter->unit = pow (10.0, svg_painter->precision);
+}
+
+void
+svg_painter_set_default_precision (int precision)
+{
+  svg_default_precision = CLAMP (precision, 0, MAX_PRECISION);
+}
+
+/*======================================================================
+//  Number formatting. All coordinates are quantized to integer
+//  multiples of 10^-precision. Relative path coordinates are then
+//  exact differences of integers, so rounding errors never
+//  accumulate along a long path.
+//----------------------------------------------------------------------
+*/
+static gint64
+svg_quantize (svg_painter_t * svg_painter, double val)
+{
+  return (gint64) floor (DEV (val) * svg_painter->unit + 0.5);
+}
+
+/* Write a quantized value with trailing zeros removed */
+static void
+svg_put_fixed (svg_painter_t * svg_painter, gint64 val)
+{
+  FILE *SVG = svg_painter->SVG;
+  int precision = svg_painter->precision;
+  gint64 unit = (gint64) svg_painter->unit;
+  gint64 frac;
+
+  if (val < 0)
+    {
+      fputc ('-', SVG);
+      val = -val;
+    }
+  fprintf (SVG, "%" G_GINT64_FORMAT, val / unit);
+  frac = val % unit;
+  if (frac)
+    {
+      char digits[MAX_PRECISION + 1];
+      int len = precision;
+
+      sprintf (digits, "%0*" G_GINT64_FORMAT, precision, frac);
+      while (len > 0 && digits[len - 1] == '0')
+        len--;
+      digits[len] = 0;
+      fprintf (SVG, ".%s", digits);
+    }
+}
+
+static void
+svg_put_pair (svg_painter_t * svg_painter, gint64 x, gint64 y)
+{
+  svg_put_fixed (svg_painter, x);
+  fputc (' ', svg_painter->SVG);
+  svg_put_fixed (svg_painter, y);
+}
+
+static void
+svg_put_value (svg_painter_t * svg_painter, double val)
+{
+  svg_put_fixed (svg_painter, svg_quantize (svg_painter, val));
+}
+
+/*======================================================================
+//  Style classes. Every distinct style declaration gets a css class
+//  that is written once, the first time it is used.
+//----------------------------------------------------------------------
+*/
+static int
+svg_get_class (svg_painter_t * svg_painter, const char *declaration)
+{
+  gpointer key, value;
+  int class_idx;
+
+  if (g_hash_table_lookup_extended (svg_painter->classes, declaration,
+                                    &key, &value))
+    return GPOINTER_TO_INT (value);
+
+  class_idx = g_hash_table_size (svg_painter->classes);
+  g_hash_table_insert (svg_painter->classes, g_strdup (declaration),
+                       GINT_TO_POINTER (class_idx));
+
+  svg_path_flush (svg_painter);
+  fprintf (svg_painter->SVG,
+           "<style type=\"text/css\"><![CDATA[.s%d{%s}]]></style>\n",
+           class_idx, declaration);
+
+  return class_idx;
+}
+
+static char *
+svg_color_string (GdkColor color)
+{
+  return g_strdup_printf ("#%02x%02x%02x",
+                          color.red / 256, color.green / 256,
+                          color.blue / 256);
+}
+
+/* The class used for the lines of the current attributes */
+static int
+svg_get_line_class (svg_painter_t * svg_painter)
+{
+  char *color = svg_color_string (svg_painter->current_color);
+  char width[G_ASCII_DTOSTR_BUF_SIZE];
+  char *declaration;
+  int class_idx;
+
+  g_ascii_formatd (width, sizeof (width), "%g",
+                   DEV (svg_painter->current_line_width));
+  declaration =
+    g_strdup_printf ("fill:none;stroke:%s;stroke-width:%s;"
+                     "stroke-linecap:round;stroke-linejoin:round",
+                     color, width);
+  class_idx = svg_get_class (svg_painter, declaration);
+  g_free (declaration);
+  g_free (color);
+
+  return class_idx;
+}
+
+/*======================================================================
+//  Paths. Consecutive subpaths of the same class are merged into a
+//  single path element, and all coordinates but the first are
+//  written relative to the previous point.
+//----------------------------------------------------------------------
+*/
+static void
+svg_path_flush (svg_painter_t * svg_painter)
+{
+  if (svg_painter->path_class < 0)
+    return;
+
+  fprintf (svg_painter->SVG, "\"/>\n");
+  svg_painter->path_class = -1;
+}
+
+static void
+svg_path_move_to (svg_painter_t * svg_painter, int class_idx,
+                  gint64 x, gint64 y)
+{
+  if (svg_painter->path_class != class_idx)
+    {
+      svg_path_flush (svg_painter);
+      fprintf (svg_painter->SVG, "<path class=\"s%d\" d=\"M", class_idx);
+      svg_put_pair (svg_painter, x, y);
+      svg_painter->path_class = class_idx;
+    }
+  else
+    {
+      fputc ('m', svg_painter->SVG);
+      svg_put_pair (svg_painter,
+                    x - svg_painter->path_x, y - svg_painter->path_y);
+    }
+  svg_painter->path_x = x;
+  svg_painter->path_y = y;
+}
+
+static void
+svg_path_line_to (svg_painter_t * svg_painter, gint64 x, gint64 y)
+{
+  fputc ('l', svg_painter->SVG);
+  svg_put_pair (svg_painter,
+                x - svg_painter->path_x, y - svg_painter->path_y);
+  svg_painter->path_x = x;
+  svg_painter->path_y = y;
+}
+
 static void
 svg_painter_set_attributes (painter_t * painter,
                             GdkColor color,
@@ -166,20 +388,15 @@ static void
 svg_painter_draw_line (painter_t * painter,
                        double x1, double y1, double x2, double y2)
 {
-  GArray *segments = g_array_new (FALSE, FALSE, sizeof (seg_t));
-  seg_t seg;
-
-  /* Convert points to segments use function below */
-  seg.x1 = x1;
-  seg.y1 = y1;
-  seg.x2 = x2;
-  seg.y2 = y2;
-
-  g_array_append_val (segments, seg);
-
-  svg_painter_draw_segments (painter, segments);
-
-  g_array_free (segments, TRUE);
+  svg_painter_t *svg_painter = (svg_painter_t *) painter;
+  int class_idx = svg_get_line_class (svg_painter);
+
+  svg_path_move_to (svg_painter, class_idx,
+                    svg_quantize (svg_painter, x1),
+                    svg_quantize (svg_painter, SVGY (y1)));
+  svg_path_line_to (svg_painter,
+                    svg_quantize (svg_painter, x2),
+                    svg_quantize (svg_painter, SVGY (y2)));
 }
 
 static void
@@ -187,36 +404,73 @@ svg_painter_draw_segments (painter_t * painter, GArray * segments)
 {
   svg_painter_t *svg_painter = (svg_painter_t *) painter;
   seg_t *segs = (seg_t *) segments->data;
+  int class_idx;
   int seg_idx;
 
-  fprintf (svg_painter->SVG,
-           "<g style=\"stroke:#%02x%02x%02x;stroke-width:%f;fill:none\">\n",
-           svg_painter->current_color.red / 256,
-           svg_painter->current_color.green / 256,
-           svg_painter->current_color.blue / 256,
-           1.0 * DEV (svg_painter->current_line_width));
+  if (segments->len == 0)
+    return;
 
-  fprintf (svg_painter->SVG, "<path d=\"");
+  class_idx = svg_get_line_class (svg_painter);
   for (seg_idx = 0; seg_idx < segments->len; seg_idx++)
     {
-      if (seg_idx == 0)
-        {
-          fprintf (svg_painter->SVG, "M %f,%f ",
-                   DEV (segs[seg_idx].x1), DEV (SVGY (segs[seg_idx].y1)));
-        }
-      else if ((segs[seg_idx].x1 != segs[seg_idx - 1].x2) ||
-               (segs[seg_idx].y1 != segs[seg_idx - 1].y2))
-        {
-          // Close polyline and open a new one
-          fprintf (svg_painter->SVG,
-                   "M %f,%f ",
-                   DEV (segs[seg_idx].x1), DEV (SVGY (segs[seg_idx].y1)));
-        }
-      fprintf (svg_painter->SVG,
-               "L %f,%f ", DEV (segs[seg_idx].x2),
-               DEV (SVGY (segs[seg_idx].y2)));
+      gint64 x1 = svg_quantize (svg_painter, segs[seg_idx].x1);
+      gint64 y1 = svg_quantize (svg_painter, SVGY (segs[seg_idx].y1));
+
+      // Open a new polyline unless we continue from the last point
+      if (seg_idx == 0
+          || x1 != svg_painter->path_x || y1 != svg_painter->path_y)
+        svg_path_move_to (svg_painter, class_idx, x1, y1);
+
+      svg_path_line_to (svg_painter,
+                        svg_quantize (svg_painter, segs[seg_idx].x2),
+                        svg_quantize (svg_painter, SVGY (segs[seg_idx].y2)));
     }
-  fprintf (svg_painter->SVG, "\"/>\n</g>\n");
+  svg_path_flush (svg_painter);
+}
+
+/* Define the symbol for an outlined mark and return its index */
+static int
+svg_get_mark_symbol (svg_painter_t * svg_painter, int mark_type,
+                     double size_x, double size_y)
+{
+  char *key = g_strdup_printf ("%d %g %g", mark_type, size_x, size_y);
+  gpointer orig_key, value;
+  int symbol_idx;
+
+  if (g_hash_table_lookup_extended (svg_painter->symbols, key,
+                                    &orig_key, &value))
+    {
+      g_free (key);
+      return GPOINTER_TO_INT (value);
+    }
+
+  symbol_idx = g_hash_table_size (svg_painter->symbols);
+  g_hash_table_insert (svg_painter->symbols, key,
+                       GINT_TO_POINTER (symbol_idx));
+
+  svg_path_flush (svg_painter);
+  fprintf (svg_painter->SVG, "<defs>");
+  if (mark_type == MARK_TYPE_CIRCLE)
+    {
+      fprintf (svg_painter->SVG, "<circle id=\"m%d\" r=\"", symbol_idx);
+      svg_put_value (svg_painter, size_x / 2);
+      fprintf (svg_painter->SVG, "\"/>");
+    }
+  else
+    {
+      fprintf (svg_painter->SVG, "<rect id=\"m%d\" x=\"", symbol_idx);
+      svg_put_value (svg_painter, -size_x / 2);
+      fprintf (svg_painter->SVG, "\" y=\"");
+      svg_put_value (svg_painter, -size_y / 2);
+      fprintf (svg_painter->SVG, "\" width=\"");
+      svg_put_value (svg_painter, size_x);
+      fprintf (svg_painter->SVG, "\" height=\"");
+      svg_put_value (svg_painter, size_y);
+      fprintf (svg_painter->SVG, "\"/>");
+    }
+  fprintf (svg_painter->SVG, "</defs>\n");
+
+  return symbol_idx;
 }
 
 static void
@@ -227,42 +481,71 @@ svg_painter_draw_marks (painter_t * painter, GArray * marks_array)
   FILE *SVG = svg_painter->SVG; /* Shortcut */
   int m_idx;
   int mark_type = svg_painter->current_mark_type;
-  int rr = svg_painter->current_color.red / 256;
-  int gg = svg_painter->current_color.green / 256;
-  int bb = svg_painter->current_color.blue / 256;
-
-  /* TBD: Compact this by defining the style once for each set of
-     points! */
-  for (m_idx = 0; m_idx < marks_array->len; m_idx++)
+  double size = svg_painter->current_mark_size_x;
+  char *color;
+  char *declaration = NULL;
+  char width[G_ASCII_DTOSTR_BUF_SIZE];
+  int class_idx;
+
+  if (marks_array->len == 0)
+    return;
+
+  color = svg_color_string (svg_painter->current_color);
+
+  /* Filled marks are drawn as zero length subpaths of a single path,
+     where the line cap gives the shape and the line width the size.
+     This only costs a relative move per mark. */
+  if (mark_type == MARK_TYPE_FCIRCLE
+      || mark_type == MARK_TYPE_FSQUARE || mark_type == MARK_TYPE_PIXEL)
     {
-      double x = marks[m_idx].x;
-      double y = SVGY (marks[m_idx].y);
-
-      /* Define postscript for the current mark */
-      if (mark_type == MARK_TYPE_FCIRCLE)
+      if (mark_type == MARK_TYPE_PIXEL)
+        size = 1;
+      g_ascii_formatd (width, sizeof (width), "%g", DEV (size));
+      declaration =
+        g_strdup_printf ("fill:none;stroke:%s;stroke-width:%s;"
+                         "stroke-linecap:%s",
+                         color, width,
+                         mark_type == MARK_TYPE_FCIRCLE ? "round" : "square");
+      class_idx = svg_get_class (svg_painter, declaration);
+
+      for (m_idx = 0; m_idx < marks_array->len; m_idx++)
         {
-          fprintf (SVG,
-                   "<circle cx=\"%f\" cy=\"%f\" r=\"%f\" fill=\"rgb(%d,%d,%d)\"/>\n",
-                   DEV (x), DEV (y),
-                   DEV (svg_painter->current_mark_size_x / 2), rr, gg, bb);
+          svg_path_move_to (svg_painter, class_idx,
+                            svg_quantize (svg_painter, marks[m_idx].x),
+                            svg_quantize (svg_painter,
+                                          SVGY (marks[m_idx].y)));
+          fprintf (SVG, "h0");
         }
-      else if (mark_type == MARK_TYPE_CIRCLE)
+      svg_path_flush (svg_painter);
+    }
+  /* Outlined marks reference a symbol that is defined once */
+  else if (mark_type == MARK_TYPE_CIRCLE || mark_type == MARK_TYPE_SQUARE)
+    {
+      int symbol_idx = svg_get_mark_symbol (svg_painter, mark_type,
+                                            svg_painter->current_mark_size_x,
+                                            svg_painter->current_mark_size_y);
+
+      g_ascii_formatd (width, sizeof (width), "%g",
+                       DEV (svg_painter->current_line_width));
+      declaration = g_strdup_printf ("fill:none;stroke:%s;stroke-width:%s",
+                                     color, width);
+      class_idx = svg_get_class (svg_painter, declaration);
+
+      svg_path_flush (svg_painter);
+      fprintf (SVG, "<g class=\"s%d\">\n", class_idx);
+      for (m_idx = 0; m_idx < marks_array->len; m_idx++)
         {
-          fprintf (SVG,
-                   "<circle cx=\"%f\" cy=\"%f\" r=\"%f\" stroke=\"rgb(%d,%d,%d)\"/> stroke_width=\"%f\"\n",
-                   DEV (x), DEV (y),
-                   DEV (svg_painter->current_mark_size_x / 2), rr, gg, bb,
-                   1.0 * DEV (svg_painter->current_line_width));
+          fprintf (SVG, "<use xlink:href=\"#m%d\" x=\"", symbol_idx);
+          svg_put_value (svg_painter, marks[m_idx].x);
+          fprintf (SVG, "\" y=\"");
+          svg_put_value (svg_painter, SVGY (marks[m_idx].y));
+          fprintf (SVG, "\"/>\n");
         }
-      /* TBD! */
-#if 0
-      else if (mark_type == MARK_TYPE_SQUARE)
-        fprintf (SVG, "");
-      else if (mark_type == MARK_TYPE_FSQUARE)
-        fprintf (SVG, "");
-#endif
+      fprintf (SVG, "</g>\n");
     }
 
+  g_free (declaration);
+  g_free (color);
 }
 
 static void
@@ -272,6 +555,7 @@ svg_painter_draw_text (struct painter_t_struct *painter,
 {
   svg_painter_t *svg_painter = (svg_painter_t *) painter;
   double text_size = svg_painter->current_text_size;
+  char *escaped_text;
   char *anchor_names[] =
     { "text-anchor=\"middle\" alignment-baseline=\"middle\"",
     "text-anchor=\"start\" alignment-baseline=\"middle\"",
@@ -310,15 +594,15 @@ svg_painter_draw_text (struct painter_t_struct *painter,
       y_pos += 0.74 * text_size;
     }
 
-  // Meanwhile do it the long and hard way...
-  fprintf (svg_painter->SVG,
-           "<text %s font-size=\"%f\" fill=\"RGB(%d,%d,%d)\" x=\"%f\" y=\"%f\">%s</text>\n",
-           anchor_names[just],
-           DEV (svg_painter->current_text_size),
-           svg_painter->current_color.red / 256,
-           svg_painter->current_color.green / 256,
-           svg_painter->current_color.blue / 256,
-           DEV (x_pos), DEV (SVGY (y_pos)), text);
+  svg_path_flush (svg_painter);
+  escaped_text = g_markup_escape_text (text, -1);
+  fprintf (svg_painter->SVG, "<text class=\"t%d\" %s x=\"",
+           style, anchor_names[just]);
+  svg_put_value (svg_painter, x_pos);
+  fprintf (svg_painter->SVG, "\" y=\"");
+  svg_put_value (svg_painter, SVGY (y_pos));
+  fprintf (svg_painter->SVG, "\">%s</text>\n", escaped_text);
+  g_free (escaped_text);
 }
 
 static void
@@ -327,7 +611,7 @@ svg_painter_set_attributes_style (painter_t * painter, int style)
   char *color_name;
   GdkColor color;
   double line_width;
-  int line_style;
+  int line_style = 0;
 
   switch (style)
     {
@@ -354,6 +638,8 @@ svg_painter_group_start (struct painter_t_struct *painter,
                          const char *group_name)
 {
   svg_painter_t *svg_painter = (svg_painter_t *) painter;
+
+  svg_path_flush (svg_painter);
   fprintf (svg_painter->SVG, "<g id=\"%s\">\n", group_name);
 }
 
@@ -363,5 +649,6 @@ svg_painter_group_end (struct painter_t_struct *painter,
 {
   svg_painter_t *svg_painter = (svg_painter_t *) painter;
 
+  svg_path_flush (svg_painter);
   fprintf (svg_painter->SVG, "</g>\n");
 }
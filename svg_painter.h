@@ -11,5 +11,7 @@
 
 painter_t *svg_painter_new (window_t * window, const char *filename);
 void svg_painter_delete (painter_t * painter);
+void svg_painter_set_precision (painter_t * painter, int precision);
+void svg_painter_set_default_precision (int precision);
 
 #endif /* SVGPAINTER */